@@ -0,0 +1,393 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+
+#include "lr.hpp"
+#include "nn/nn_impl.hpp"
+#include "faust/faust_impl.hpp"
+
+// A pure interpreter workload: one sine oscillator computed per sample,
+// without any io words so the timing only contains dispatch and math.
+static const char* patch = R"(
+0.0 "phase" !~
+"phase" @ sin
+"phase" @ 440.0 (2.0 math.pi *) * "SampleRate" @~ inv * +
+(2.0 math.pi *) swap % "phase" !
+0.5 * drop
+)";
+
+// The same oscillator wrapped in nested user words.
+static const char* nested_patch = R"(
+%def phase_inc
+    (2.0 math.pi *) * "SampleRate" @~ inv *
+%end
+%def wrap
+    (2.0 math.pi *) swap %
+%end
+%def osc
+    0.0 "phase" !~
+    "phase" @ sin
+    swap "phase" @ swap phase_inc + wrap "phase" !
+%end
+440.0 osc 0.5 * drop
+)";
+
+// A modulation chain over 65536 samples blocks, every buffer is far bigger than L1.
+static const char* vector_patch = R"(
+0.3 65536 numbers~ "a" !~
+65536 randoms~ "b" !~
+0.5 "a" @ "b" @ * + "a" @ * "b" @ + 0.25 swap * "a" @ swap - abs "b" @ * "r" !
+)";
+
+// Transcendental words over 4096 samples blocks.
+static const char* math_patch = R"(
+4096 randoms~ "x" !~
+"x" @ sin "x" @ cos * "x" @ exp tanh + 1.5 "x" @ + log * "r" !
+)";
+
+// An oscillator bank over wrapped phases, the table sine against sin.
+static const char* sine_patch = R"(
+4096 randoms~ 3.14 swap * "x" !~
+"x" @ sin "x" @ 2 swap * sin + "x" @ 3 swap * sin + "r" !
+)";
+static const char* table_patch = R"(
+4096 randoms~ 3.14 swap * "x" !~
+"x" @ math.sin_table "x" @ 2 swap * math.sin_table + "x" @ 3 swap * math.sin_table + "r" !
+)";
+
+// Two independent chains over 65536 samples blocks, only their sum joins them.
+static const char* branch_patch = R"(
+0.3 65536 numbers~ "a" !~
+0.7 65536 numbers~ "b" !~
+"a" @ sin "a" @ cos * "a" @ exp tanh + 1.5 "a" @ + log * "x" !
+"b" @ sin "b" @ cos * "b" @ exp tanh + 1.5 "b" @ + log * "y" !
+"x" @ "y" @ + "r" !
+)";
+
+// The same chains over 64 samples blocks, cheaper than a thread wake-up.
+static const char* small_branch_patch = R"(
+0.3 64 numbers~ "a" !~
+0.7 64 numbers~ "b" !~
+"a" @ sin "a" @ cos * "a" @ exp tanh + 1.5 "a" @ + log * "x" !
+"b" @ sin "b" @ cos * "b" @ exp tanh + 1.5 "b" @ + log * "y" !
+"x" @ "y" @ + "r" !
+)";
+
+// The same work split into two stages, the second one gets the block of the first one a run later.
+static const char* stage_patch = R"(
+0.3 65536 numbers~ "a" !~
+"a" @ sin "a" @ cos * "a" @ exp tanh + 1.5 "a" @ + log *
+%stage
+"b" !
+"b" @ sin "b" @ cos * "b" @ exp tanh + 1.5 "b" @ + log * "r" !
+)";
+
+// A per-sample patch whose gain is computed from a slow LFO, the gain math only reaches the
+// number of a "n v -- v" word.
+static const char* control_patch = R"(
+0.0 "lfo" !~
+"lfo" @ 0.001 + "lfo" !
+"lfo" @ sin 0.5 * 0.5 + 3.0 * exp 0.1 * 1 ones~ * "out" !
+)";
+
+// Static words in a per-sample patch, they only repeat their first results.
+static const char* static_patch = R"(
+0.0 "phase" !~
+"phase" @ 0.01 + "phase" !
+16 zeros~ 16 ones~ + 0.5 16 numbers~ * drop
+"SampleRate" @~ inv "phase" @ * drop
+)";
+
+// An additive bank of 64 partials, kept as one loop body or unrolled ( where partial numbers are folded ).
+static const char* loop_patch = R"(
+0.0 "phase" !~
+0.0 "sum" !
+%loop k 1 65
+    "phase" @ "k" * sin "k" inv * "sum" @ + "sum" !
+%end
+"phase" @ 440.0 (2.0 math.pi *) * "SampleRate" @~ inv * + (2.0 math.pi *) swap % "phase" !
+)";
+
+// A sparse score over 64 samples blocks, a short tone every 8 seconds through the reverb and WaveNet chain.
+static const char* sparse_patch = R"(
+0.0 "t" !~
+"t" @ 1.05 - floor 0.0864 block.phase sin *
+16000 faust.re.freeverb 8 3 8 3 "./examples/assets/dizi.yaml" nn.wavenet "r" !
+"t" @ 0.0005 + 1.0 swap % "t" !
+)";
+
+// A generated patch with many user words, for build time.
+static std::string large_patch(size_t voices) {
+    std::string txt = "0.0 \"phase\" !~\n";
+    for (size_t i = 0; i < voices; i++) {
+        std::string n = std::to_string(i);
+        txt += "%def voice" + n + "   ; partial " + n + "\n";
+        txt += "    \"phase\" @ " + n + ".0 * sin (1.0 " + n + ".0 +) inv *\n";
+        txt += "%end\n";
+    }
+    txt += "0.0\n";
+    for (size_t i = 0; i < voices; i++) {
+        txt += "voice" + std::to_string(i) + " +\n";
+    }
+    txt += "drop \"phase\" @ 0.01 + \"phase\" !\n";
+    return txt;
+}
+
+static double build_patch(const std::string& txt, const char* cache) {
+    auto begin = std::chrono::high_resolution_clock::now();
+    lr::Enviroment env(16000);
+    if ( cache == nullptr ) {
+        env.build(txt);
+    } else {
+        env.build(txt, cache);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+static size_t count_words(const std::string& txt) {
+    std::string clean;
+    for (auto c : txt) {
+        if ( c == '(' || c == ')' ) {
+            c = ' ';
+        }
+        clean.push_back(c);
+    }
+
+    size_t n = 0;
+    std::istringstream ss(clean);
+    std::string token;
+    while ( ss >> token ) {
+        n++;
+    }
+    return n;
+}
+
+using Options = std::vector<std::pair<const char*, lr::Enviroment::SettingValue>>;
+
+static double run_patch(const char* txt, const Options& options, size_t samples) {
+    lr::Enviroment env(16000);
+    lr::faust::init_words(env);
+    lr::nn::init_words(env);
+    for (auto& o : options) {
+        env.set_config(o.first, o.second);
+    }
+
+    auto rt = env.build(txt);
+    rt.run();   // warm up static words
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < samples; i++) {
+        rt.run();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+int main(int argc, const char* argv[]) {
+    size_t samples = 16000 * 60;
+    if ( argc > 1 ) {
+        samples = std::stoul(argv[1]);
+    }
+
+    const double words = count_words(patch) * (double)samples;
+
+    // dispatch is measured on stack code
+    double switched = run_patch(patch, { {"RegisterCode", false}, {"Peephole", false}, {"ThreadedCode", false} }, samples);
+    double threaded = run_patch(patch, { {"RegisterCode", false}, {"Peephole", false}, {"ThreadedCode", true} }, samples);
+    double peephole = run_patch(patch, { {"RegisterCode", false} }, samples);
+    double registered = run_patch(patch, { {"RegisterCode", true} }, samples);
+
+    std::cout << "words per run:\t" << count_words(patch) << std::endl;
+    std::cout << "switch loop:\t" << switched / words << " ns/word" << std::endl;
+    std::cout << "threaded code:\t" << threaded / words << " ns/word" << std::endl;
+    std::cout << "saved:\t\t" << (switched - threaded) / words << " ns/word" << std::endl;
+    std::cout << "peephole:\t" << peephole / words << " ns/word" << std::endl;
+    std::cout << "register code:\t" << registered / words << " ns/word" << std::endl;
+
+    double called = run_patch(nested_patch, { {"InlineUserWords", false} }, samples);
+    double inlined = run_patch(nested_patch, { {"InlineUserWords", true} }, samples);
+    double called_stack = run_patch(nested_patch, { {"InlineUserWords", false}, {"RegisterCode", false} }, samples);
+    double inlined_stack = run_patch(nested_patch, { {"InlineUserWords", true}, {"RegisterCode", false} }, samples);
+
+    std::cout << "nested user words:" << std::endl;
+    std::cout << "called:\t\t" << called / samples << " ns/run, stack code " << called_stack / samples << " ns/run" << std::endl;
+    std::cout << "inlined:\t" << inlined / samples << " ns/run, stack code " << inlined_stack / samples << " ns/run" << std::endl;
+    std::cout << "flat patch:\t" << registered / samples << " ns/run, stack code " << peephole / samples << " ns/run" << std::endl;
+
+    double every = run_patch(static_patch, { {"SteadyState", false} }, samples);
+    double steady = run_patch(static_patch, { {"SteadyState", true} }, samples);
+    double every_stack = run_patch(static_patch, { {"SteadyState", false}, {"RegisterCode", false} }, samples);
+    double steady_stack = run_patch(static_patch, { {"SteadyState", true}, {"RegisterCode", false} }, samples);
+
+    std::cout << "static words:" << std::endl;
+    std::cout << "every run:\t" << every / samples << " ns/run, stack code " << every_stack / samples << " ns/run" << std::endl;
+    std::cout << "steady state:\t" << steady / samples << " ns/run, stack code " << steady_stack / samples << " ns/run" << std::endl;
+
+    double sampled = run_patch(control_patch, { {"ControlRate", 1} }, samples);
+    double decimated = run_patch(control_patch, { {"ControlRate", 16} }, samples);
+
+    std::cout << "control rate:" << std::endl;
+    std::cout << "every sample:\t" << sampled / samples << " ns/run" << std::endl;
+    std::cout << "every 16:\t" << decimated / samples << " ns/run" << std::endl;
+
+    size_t partials = samples / 64 + 1;
+    double unrolled = run_patch(loop_patch, { {"LoopOpcode", false} }, partials);
+    double looped = run_patch(loop_patch, { {"LoopOpcode", true}, {"UnrollLimit", 0} }, partials);
+    double unrolled_stack = run_patch(loop_patch, { {"LoopOpcode", false}, {"RegisterCode", false} }, partials);
+    double looped_stack = run_patch(loop_patch, { {"LoopOpcode", true}, {"UnrollLimit", 0}, {"RegisterCode", false} }, partials);
+
+    std::cout << "counted loop:" << std::endl;
+    std::cout << "unrolled:\t" << unrolled / partials << " ns/run, stack code " << unrolled_stack / partials << " ns/run" << std::endl;
+    std::cout << "loop opcode:\t" << looped / partials << " ns/run, stack code " << looped_stack / partials << " ns/run" << std::endl;
+
+    size_t blocks = samples / 1024 + 1;
+    double owned = run_patch(vector_patch, { {"FuseVectorWords", false}, {"BufferArena", false} }, blocks);
+    double unfused = run_patch(vector_patch, { {"FuseVectorWords", false} }, blocks);
+    double fused = run_patch(vector_patch, { {"FuseVectorWords", true} }, blocks);
+
+    std::cout << "vector chain:" << std::endl;
+    std::cout << "word buffers:\t" << owned / blocks / 65536 << " ns/sample" << std::endl;
+    std::cout << "buffer arena:\t" << unfused / blocks / 65536 << " ns/sample" << std::endl;
+    std::cout << "fused:\t\t" << fused / blocks / 65536 << " ns/sample" << std::endl;
+
+    blocks = samples / 64 + 1;
+    double precise = run_patch(math_patch, { {"FastMath", false} }, blocks);
+    double fast = run_patch(math_patch, { {"FastMath", true} }, blocks);
+
+    std::cout << "transcendental words:" << std::endl;
+    std::cout << "precise:\t" << precise / blocks / 4096 << " ns/sample" << std::endl;
+    std::cout << "fast math:\t" << fast / blocks / 4096 << " ns/sample" << std::endl;
+
+    double sine = run_patch(sine_patch, { {"FastMath", false} }, blocks);
+    double fast_sine = run_patch(sine_patch, { {"FastMath", true} }, blocks);
+    double table = run_patch(table_patch, {}, blocks);
+
+    std::cout << "sine bank:" << std::endl;
+    std::cout << "precise:\t" << sine / blocks / 4096 << " ns/sample" << std::endl;
+    std::cout << "fast math:\t" << fast_sine / blocks / 4096 << " ns/sample" << std::endl;
+    std::cout << "table:\t\t" << table / blocks / 4096 << " ns/sample" << std::endl;
+
+    blocks = samples / 4096 + 1;
+    double serial = run_patch(branch_patch, { {"ParallelBranches", false} }, blocks);
+    double parallel = run_patch(branch_patch, { {"ParallelBranches", true} }, blocks);
+
+    // short chains stay on one thread, they are below ParallelCost
+    size_t small_blocks = samples / 64 + 1;
+    double small_serial = run_patch(small_branch_patch, { {"ParallelBranches", false} }, small_blocks);
+    double small_parallel = run_patch(small_branch_patch, { {"ParallelBranches", true} }, small_blocks);
+
+    std::cout << "independent branches, " << std::thread::hardware_concurrency() << " cores:" << std::endl;
+    std::cout << "serial:\t\t" << serial / blocks / 65536 << " ns/sample" << std::endl;
+    std::cout << "parallel:\t" << parallel / blocks / 65536 << " ns/sample" << std::endl;
+    std::cout << "64 samples serial:\t" << small_serial / small_blocks / 64 << " ns/sample" << std::endl;
+    std::cout << "64 samples parallel:\t" << small_parallel / small_blocks / 64 << " ns/sample" << std::endl;
+
+    lr::Enviroment stage_env(16000);
+    auto joined = stage_env.build(stage_patch);
+    joined.run();
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < blocks; i++) {
+        joined.run();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double one = std::chrono::duration<double, std::nano>(end - begin).count();
+
+    // a render waits for room in the ring, the time includes the last blocks of the second stage
+    lr::Pipeline pipeline(stage_env, stage_patch);
+    pipeline.run();
+    pipeline.draining();
+    begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < blocks; i++) {
+        while ( !pipeline.ready() ) {
+            std::this_thread::yield();
+        }
+        pipeline.run();
+    }
+    pipeline.draining();
+    end = std::chrono::high_resolution_clock::now();
+    double staged = std::chrono::duration<double, std::nano>(end - begin).count();
+
+    // an audio callback doesn't wait, it pays the first stage only and drops blocks on overrun
+    begin = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < blocks; i++) {
+        pipeline.run();
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double callback = std::chrono::duration<double, std::nano>(end - begin).count();
+    pipeline.draining();
+
+    std::cout << "pipeline stages:" << std::endl;
+    std::cout << "one runtime:\t" << one / blocks / 65536 << " ns/sample" << std::endl;
+    std::cout << "two stages:\t" << staged / blocks / 65536 << " ns/sample" << std::endl;
+    std::cout << "callback:\t" << callback / blocks / 65536 << " ns/sample, " << pipeline.dropped() << " blocks dropped" << std::endl;
+
+    blocks = samples / 320 + 1;
+    double busy = run_patch(sparse_patch, { {"BlockSize", 64}, {"SkipSilence", false} }, blocks);
+    double skipped = run_patch(sparse_patch, { {"BlockSize", 64}, {"SkipSilence", true} }, blocks);
+
+    std::cout << "sparse score:" << std::endl;
+    std::cout << "every block:\t" << busy / blocks / 64 << " ns/sample" << std::endl;
+    std::cout << "skip silence:\t" << skipped / blocks / 64 << " ns/sample" << std::endl;
+
+    // the swap happens inside one run(), the new program is built on a worker thread
+    lr::Enviroment live_env(16000);
+    lr::LivePatch live(live_env, large_patch(200));
+    live.run();
+    auto reloading = std::chrono::high_resolution_clock::now();
+    live.reload(large_patch(201));
+    while ( !live.pending() ) {
+        std::this_thread::yield();
+    }
+    auto swapping = std::chrono::high_resolution_clock::now();
+    live.run();
+    auto swapped = std::chrono::high_resolution_clock::now();
+    live.run();
+    auto next = std::chrono::high_resolution_clock::now();
+
+    std::cout << "live reload, 200 user words:" << std::endl;
+    std::cout << "worker build:\t" << std::chrono::duration<double, std::milli>(swapping - reloading).count() << " ms" << std::endl;
+    std::cout << "swap run:\t" << std::chrono::duration<double, std::micro>(swapped - swapping).count() << " us" << std::endl;
+    std::cout << "next run:\t" << std::chrono::duration<double, std::micro>(next - swapped).count() << " us" << std::endl;
+
+    // voices are cloned from a runtime which never ran
+    auto voice_patch = large_patch(200);
+    lr::Enviroment voice_env(16000);
+    auto image = voice_env.build(voice_patch);
+    double rebuilt = build_patch(voice_patch, nullptr);
+
+    const size_t voices = 16;
+    std::vector<lr::Runtime*> clones;
+    auto cloning = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < voices; i++) {
+        clones.push_back( image.clone() );
+    }
+    auto cloned = std::chrono::high_resolution_clock::now();
+    for (auto voice : clones) {
+        voice->run();
+        delete voice;
+    }
+
+    std::cout << "voices, 200 user words:" << std::endl;
+    std::cout << "built:\t\t" << rebuilt << " ms" << std::endl;
+    std::cout << "cloned:\t\t" << std::chrono::duration<double, std::milli>(cloned - cloning).count() / voices << " ms" << std::endl;
+
+    auto large = large_patch(2000);
+    const char* cache = "bench.lrc";
+    std::remove(cache);
+    double compiled = build_patch(large, nullptr);
+    double written = build_patch(large, cache);
+    double cached = build_patch(large, cache);
+    std::remove(cache);
+
+    // the .lrc cache holds the compiled code only, linking and the later passes run on every build
+    std::cout << "build, .lrc compile cache, 2000 user words:" << std::endl;
+    std::cout << "compiled:\t" << compiled << " ms" << std::endl;
+    std::cout << "cache written:\t" << written << " ms" << std::endl;
+    std::cout << "cache read:\t" << cached << " ms" << std::endl;
+}
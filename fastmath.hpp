@@ -0,0 +1,206 @@
+#ifndef _LOTUS_RIVER_FASTMATH_H_
+#define _LOTUS_RIVER_FASTMATH_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/*
+Fast transcendental functions for float, selected by the "FastMath" setting.
+
+Every function is branch free so the block loops below are vectorized by the compiler
+( this needs -fno-trapping-math, see Makefile ). Maximum errors measured against double libm:
+
+Function        Method                                      Range               Max error
+exp             Cephes polynomial, 2^n by exponent bits     [-87, 88]           8.1e-8 relative
+log             Cephes polynomial on the mantissa           (0, FLT_MAX]        8.1e-8 relative, absolute when |log x| < 1
+sin, cos        Cephes polynomials, pi/4 reduction          [-8192, 8192]       7.8e-8 absolute
+tanh            1 - 2 / (exp(2x) + 1)                       all floats          1.8e-7 absolute
+sigmoid         1 / (1 + exp(-x))                           all floats          9.0e-8 absolute
+sin_table       4096 points table, linear interpolation     [-2pi, 2pi]         6.4e-7 absolute, 5.5e-6 when |x| < 64
+
+For reference float std::sin is within 3.3e-8. exp saturates to 1.2e-38 and 1.7e38, log returns
+-inf for 0 and nan for negative numbers. The table sine loses phase precision with |x|, use it only
+with wrapped phases. It is the math.sin_table word, its table lookups don't vectorize and in blocks
+the fast sin polynomial is quicker ( see bench ).
+*/
+
+namespace lr { namespace fastmath {
+
+inline float as_float(int32_t i) {
+    float f;
+    memcpy(&f, &i, sizeof(f));
+    return f;
+}
+
+inline int32_t as_int(float f) {
+    int32_t i;
+    memcpy(&i, &f, sizeof(i));
+    return i;
+}
+
+// floor without libm, SSE2 has no vector rounding
+inline float floor(float x) {
+    float t = (float)(int32_t)x;
+    return t - (t > x ? 1.0f : 0.0f);
+}
+
+inline float exp(float x) {
+    // written as min / max so it maps to single instructions
+    x = x < 88.0f ? x : 88.0f;
+    x = x > -87.3365447504f ? x : -87.3365447504f;
+
+    // x = n * ln2 + r,  |r| <= ln2 / 2, the offset keeps truncation a floor
+    int32_t n = (int32_t)(x * 1.44269504088896341f + 127.5f) - 127;
+    float fn = (float)n;
+    float r = x - fn * 0.693359375f;
+    r = r - fn * -2.12194440e-4f;
+
+    float z = r * r;
+    float p = 1.9875691500E-4f;
+    p = p * r + 1.3981999507E-3f;
+    p = p * r + 8.3334519073E-3f;
+    p = p * r + 4.1665795894E-2f;
+    p = p * r + 1.6666665459E-1f;
+    p = p * r + 5.0000001201E-1f;
+    p = p * z + r + 1.0f;
+
+    return p * as_float( (n + 127) << 23 );
+}
+
+inline float log(float x) {
+    const float invalid = x < 0.0f ? NAN : -INFINITY;
+    const bool positive = x > 0.0f;
+    x = x < 1.17549435e-38f ? 1.17549435e-38f : x;
+
+    // x = m * 2^e, m in [sqrt(1/2), sqrt(2))
+    int32_t bits = as_int(x);
+    int32_t e = ((bits >> 23) & 0xff) - 126;
+    float m = as_float( (bits & 0x007fffff) | 0x3f000000 );
+
+    const bool small = m < 0.707106781186547524f;
+    e = small ? e - 1 : e;
+    m = small ? m + m - 1.0f : m - 1.0f;
+
+    float z = m * m;
+    float p = 7.0376836292E-2f;
+    p = p * m - 1.1514610310E-1f;
+    p = p * m + 1.1676998740E-1f;
+    p = p * m - 1.2420140846E-1f;
+    p = p * m + 1.4249322787E-1f;
+    p = p * m - 1.6668057665E-1f;
+    p = p * m + 2.0000714765E-1f;
+    p = p * m - 2.4999993993E-1f;
+    p = p * m + 3.3333331174E-1f;
+    p = p * m * z;
+
+    float fe = (float)e;
+    p = p + fe * -2.12194440e-4f;
+    p = p - 0.5f * z;
+    float y = m + p + fe * 0.693359375f;
+
+    return positive ? y : invalid;
+}
+
+inline float sin(float x) {
+    float sign = x < 0.0f ? -1.0f : 1.0f;
+    x = std::fabs(x);
+
+    // j is the even octant, reducing x to [-pi/4, pi/4] with extended precision pi/4
+    int32_t j = (int32_t)(x * 1.27323954473516f);
+    j = (j + 1) & ~1;
+    float y = (float)j;
+    x = ((x - y * 0.78515625f) - y * 2.4187564849853515625e-4f) - y * 3.77489497744594108e-8f;
+
+    float z = x * x;
+    float pc = 2.443315711809948E-005f;
+    pc = pc * z - 1.388731625493765E-003f;
+    pc = pc * z + 4.166664568298827E-002f;
+    pc = pc * z * z - 0.5f * z + 1.0f;
+
+    float ps = -1.9515295891E-4f;
+    ps = ps * z + 8.3321608736E-3f;
+    ps = ps * z - 1.6666654611E-1f;
+    ps = ps * z * x + x;
+
+    float r = (j & 2) ? pc : ps;
+    sign = (j & 4) ? -sign : sign;
+    return sign * r;
+}
+
+inline float cos(float x) {
+    x = std::fabs(x);
+
+    int32_t j = (int32_t)(x * 1.27323954473516f);
+    j = (j + 1) & ~1;
+    float y = (float)j;
+    x = ((x - y * 0.78515625f) - y * 2.4187564849853515625e-4f) - y * 3.77489497744594108e-8f;
+
+    float z = x * x;
+    float pc = 2.443315711809948E-005f;
+    pc = pc * z - 1.388731625493765E-003f;
+    pc = pc * z + 4.166664568298827E-002f;
+    pc = pc * z * z - 0.5f * z + 1.0f;
+
+    float ps = -1.9515295891E-4f;
+    ps = ps * z + 8.3321608736E-3f;
+    ps = ps * z - 1.6666654611E-1f;
+    ps = ps * z * x + x;
+
+    // cos is sin shifted by two octants
+    j = j + 2;
+    float r = (j & 2) ? pc : ps;
+    return (j & 4) ? -r : r;
+}
+
+inline float tanh(float x) {
+    float e = fastmath::exp(2.0f * x);
+    return 1.0f - 2.0f / (e + 1.0f);
+}
+
+inline float sigmoid(float x) {
+    return 1.0f / (1.0f + fastmath::exp(-x));
+}
+
+struct SineTable {
+    static const int SIZE = 4096;
+    float values[SIZE + 1];
+
+    SineTable() {
+        for (int i = 0; i <= SIZE; i++) {
+            values[i] = std::sin( 2.0 * M_PI * i / SIZE );
+        }
+    }
+};
+
+inline const SineTable sine_table;
+
+inline float sin_table(float x) {
+    float turns = x * 0.159154943091895f;
+    turns = turns - fastmath::floor(turns);
+    float pos = turns * SineTable::SIZE;
+    int32_t i = (int32_t)pos;
+    i = i < SineTable::SIZE ? i : SineTable::SIZE - 1;
+    float frac = pos - (float)i;
+    return sine_table.values[i] + frac * (sine_table.values[i + 1] - sine_table.values[i]);
+}
+
+// block versions, vectorized by the compiler
+#define FASTMATH_BLOCK_LR(fn)                                   \
+inline void fn(const float* x, float* y, size_t n) {            \
+    for (size_t i = 0; i < n; i++) {                            \
+        y[i] = fastmath::fn(x[i]);                              \
+    }                                                           \
+}
+
+FASTMATH_BLOCK_LR(exp)
+FASTMATH_BLOCK_LR(log)
+FASTMATH_BLOCK_LR(sin)
+FASTMATH_BLOCK_LR(cos)
+FASTMATH_BLOCK_LR(tanh)
+FASTMATH_BLOCK_LR(sigmoid)
+FASTMATH_BLOCK_LR(sin_table)
+
+}}
+
+#endif
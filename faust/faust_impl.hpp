@@ -8,14 +8,15 @@
 namespace lr { namespace faust {
 
 void init_words(Enviroment& env) {
-    env.insert_native_word("faust.osc.sine", OscSineWord::creator);
-    env.insert_native_word("faust.osc.sawtooth", OscSawtoothWord::creator);
-    env.insert_native_word("faust.osc.square", OscSquareWord::creator);
-    env.insert_native_word("faust.osc.triangle", OscTriangleWord::creator);
+    // the frequency is a control input, block size and sample rate are configuration
+    env.insert_native_word("faust.osc.sine", OscSineWord::creator, { {"n n n -- v", nullptr, "c . ."} });
+    env.insert_native_word("faust.osc.sawtooth", OscSawtoothWord::creator, { {"n n n -- v", nullptr, "c . ."} });
+    env.insert_native_word("faust.osc.square", OscSquareWord::creator, { {"n n n -- v", nullptr, "c . ."} });
+    env.insert_native_word("faust.osc.triangle", OscTriangleWord::creator, { {"n n n -- v", nullptr, "c . ."} });
 
-    env.insert_native_word("faust.no.white", NoiseWhiteWord::creator);
+    env.insert_native_word("faust.no.white", NoiseWhiteWord::creator, {"n -- v"});
 
-    env.insert_native_word("faust.re.freeverb", ReFreeverbWord::creator);
+    env.insert_native_word("faust.re.freeverb", ReFreeverbWord::creator, {"v n -- v"});
 }
 
 }}
@@ -15,21 +15,23 @@ OscSineWord::~OscSineWord() {
         delete dsp;
     }
 }
-void OscSineWord::run(Stack& stack) {
-    int sr = stack.pop_number();
-    int bs = stack.pop_number();
-    TNT freq = stack.pop_number();
-    if ( dsp == nullptr) {
-        dsp = new dsp::OscSine();
-        dsp->init(sr);
-        dsp->buildUserInterface(&ui);
+void OscSineWord::configure(std::vector<Cell>& args) {
+    int bs = args[0].as_number();
+    int sr = args[1].as_number();
 
-        vec = Vec::Zero(bs, 1);
-    }
+    dsp = new dsp::OscSine();
+    dsp->init(sr);
+    dsp->buildUserInterface(&ui);
+
+    vec = Vec::Zero(bs, 1);
+}
+
+void OscSineWord::run_configured(Stack& stack) {
+    TNT freq = stack.pop_number();
 
     *ui.freq = freq;
     TNT* d = vec.data();
-    dsp->compute(bs, nullptr, &d);
+    dsp->compute(vec.size(), nullptr, &d);
 
     stack.push_vector(&vec);
 }
@@ -40,21 +42,23 @@ OscSawtoothWord::~OscSawtoothWord() {
     }
 }
 
-void OscSawtoothWord::run(Stack& stack) {
-    int sr = stack.pop_number();
-    int bs = stack.pop_number();
-    TNT freq = stack.pop_number();
-    if ( dsp == nullptr) {
-        dsp = new dsp::OscSawtooth();
-        dsp->init(sr);
-        dsp->buildUserInterface(&ui);
+void OscSawtoothWord::configure(std::vector<Cell>& args) {
+    int bs = args[0].as_number();
+    int sr = args[1].as_number();
 
-        vec = Vec::Zero(bs, 1);
-    }
+    dsp = new dsp::OscSawtooth();
+    dsp->init(sr);
+    dsp->buildUserInterface(&ui);
+
+    vec = Vec::Zero(bs, 1);
+}
+
+void OscSawtoothWord::run_configured(Stack& stack) {
+    TNT freq = stack.pop_number();
 
     *ui.freq = freq;
     TNT* d = vec.data();
-    dsp->compute(bs, nullptr, &d);
+    dsp->compute(vec.size(), nullptr, &d);
 
     stack.push_vector(&vec);
 }
@@ -64,21 +68,23 @@ OscSquareWord::~OscSquareWord() {
         delete dsp;
     }
 }
-void OscSquareWord::run(Stack& stack) {
-    int sr = stack.pop_number();
-    int bs = stack.pop_number();
-    TNT freq = stack.pop_number();
-    if ( dsp == nullptr) {
-        dsp = new dsp::OscSquare();
-        dsp->init(sr);
-        dsp->buildUserInterface(&ui);
+void OscSquareWord::configure(std::vector<Cell>& args) {
+    int bs = args[0].as_number();
+    int sr = args[1].as_number();
 
-        vec = Vec::Zero(bs, 1);
-    }
+    dsp = new dsp::OscSquare();
+    dsp->init(sr);
+    dsp->buildUserInterface(&ui);
+
+    vec = Vec::Zero(bs, 1);
+}
+
+void OscSquareWord::run_configured(Stack& stack) {
+    TNT freq = stack.pop_number();
 
     *ui.freq = freq;
     TNT* d = vec.data();
-    dsp->compute(bs, nullptr, &d);
+    dsp->compute(vec.size(), nullptr, &d);
 
     stack.push_vector(&vec);
 }
@@ -88,21 +94,23 @@ OscTriangleWord::~OscTriangleWord() {
         delete dsp;
     }
 }
-void OscTriangleWord::run(Stack& stack) {
-    int sr = stack.pop_number();
-    int bs = stack.pop_number();
-    TNT freq = stack.pop_number();
-    if ( dsp == nullptr) {
-        dsp = new dsp::OscTriangle();
-        dsp->init(sr);
-        dsp->buildUserInterface(&ui);
+void OscTriangleWord::configure(std::vector<Cell>& args) {
+    int bs = args[0].as_number();
+    int sr = args[1].as_number();
 
-        vec = Vec::Zero(bs, 1);
-    }
+    dsp = new dsp::OscTriangle();
+    dsp->init(sr);
+    dsp->buildUserInterface(&ui);
+
+    vec = Vec::Zero(bs, 1);
+}
+
+void OscTriangleWord::run_configured(Stack& stack) {
+    TNT freq = stack.pop_number();
 
     *ui.freq = freq;
     TNT* d = vec.data();
-    dsp->compute(bs, nullptr, &d);
+    dsp->compute(vec.size(), nullptr, &d);
 
     stack.push_vector(&vec);
 }
@@ -114,17 +122,18 @@ NoiseWhiteWord::~NoiseWhiteWord() {
     }
 }
 
-void NoiseWhiteWord::run(Stack& stack) {
-    int bs = stack.pop_number();
-    if ( dsp == nullptr) {
-        dsp = new dsp::NoiseWhite();
-        dsp->init(44100);
-        dsp->buildUserInterface(&ui);
-        vec = Vec::Zero(bs, 1);
-    }
+void NoiseWhiteWord::configure(std::vector<Cell>& args) {
+    int bs = args[0].as_number();
+
+    dsp = new dsp::NoiseWhite();
+    dsp->init(44100);
+    dsp->buildUserInterface(&ui);
+    vec = Vec::Zero(bs, 1);
+}
 
+void NoiseWhiteWord::run_configured(Stack& stack) {
     TNT* d = vec.data();
-    dsp->compute(bs, nullptr, &d);
+    dsp->compute(vec.size(), nullptr, &d);
 
     stack.push_vector(&vec);
 }
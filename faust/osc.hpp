@@ -15,10 +15,12 @@ namespace dsp {
 
 namespace lr { namespace faust {
 
-struct OscSineWord : public NativeWord {
-    OscSineWord() { dsp = nullptr; }
+struct OscSineWord : public ConfigNativeWord {
+    // freq bs sr, block size and sample rate are configuration
+    OscSineWord() : ConfigNativeWord(2) { dsp = nullptr; }
     virtual ~OscSineWord();
-    virtual void run(Stack& stack);
+    virtual void configure(std::vector<Cell>& args);
+    virtual void run_configured(Stack& stack);
 
     NWORD_CREATOR_DEFINE_LR(OscSineWord)
 
@@ -29,10 +31,11 @@ private:
 };
 
 
-struct OscSawtoothWord : public NativeWord {
-    OscSawtoothWord() { dsp = nullptr; }
+struct OscSawtoothWord : public ConfigNativeWord {
+    OscSawtoothWord() : ConfigNativeWord(2) { dsp = nullptr; }
     virtual ~OscSawtoothWord();
-    virtual void run(Stack& stack);
+    virtual void configure(std::vector<Cell>& args);
+    virtual void run_configured(Stack& stack);
 
     NWORD_CREATOR_DEFINE_LR(OscSawtoothWord)
 private:
@@ -41,10 +44,11 @@ private:
     Vec vec;
 };
 
-struct OscSquareWord : public NativeWord {
-    OscSquareWord() { dsp = nullptr; }
+struct OscSquareWord : public ConfigNativeWord {
+    OscSquareWord() : ConfigNativeWord(2) { dsp = nullptr; }
     virtual ~OscSquareWord();
-    virtual void run(Stack& stack);
+    virtual void configure(std::vector<Cell>& args);
+    virtual void run_configured(Stack& stack);
 
     NWORD_CREATOR_DEFINE_LR(OscSquareWord)
 private:
@@ -53,10 +57,11 @@ private:
     Vec vec;
 };
 
-struct OscTriangleWord : public NativeWord {
-    OscTriangleWord() { dsp = nullptr; }
+struct OscTriangleWord : public ConfigNativeWord {
+    OscTriangleWord() : ConfigNativeWord(2) { dsp = nullptr; }
     virtual ~OscTriangleWord();
-    virtual void run(Stack& stack);
+    virtual void configure(std::vector<Cell>& args);
+    virtual void run_configured(Stack& stack);
 
     NWORD_CREATOR_DEFINE_LR(OscTriangleWord)
 private:
@@ -66,10 +71,11 @@ private:
 };
 
 
-struct NoiseWhiteWord : public NativeWord {
-    NoiseWhiteWord() { dsp = nullptr; }
+struct NoiseWhiteWord : public ConfigNativeWord {
+    NoiseWhiteWord() : ConfigNativeWord(1) { dsp = nullptr; }
     virtual ~NoiseWhiteWord();
-    virtual void run(Stack& stack);
+    virtual void configure(std::vector<Cell>& args);
+    virtual void run_configured(Stack& stack);
 
     NWORD_CREATOR_DEFINE_LR(NoiseWhiteWord)
 private:
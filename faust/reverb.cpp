@@ -6,27 +6,48 @@
 
 namespace lr { namespace faust {
 
+// -100 dB, the tail is cut below it
+static const TNT TAIL_THRESHOLD = 1e-5;
+// the longest delay line of the combs, input is still ringing in them until it passed through
+static const size_t LONGEST_DELAY = 8192;
+
 ReFreeverbWord::~ReFreeverbWord() {
     if ( dsp != nullptr ) {
         delete dsp;
     }
 }
-void ReFreeverbWord::run(Stack& stack) {
-    int sr = stack.pop_number();
-    auto vin = stack.pop_vector();
+void ReFreeverbWord::configure(std::vector<Cell>& args) {
+    int sr = args[0].as_number();
 
-    if ( dsp == nullptr) {
-        dsp = new dsp::ReFreeverb();
-        dsp->init(sr);
-    }
+    dsp = new dsp::ReFreeverb();
+    dsp->init(sr);
+}
+
+void ReFreeverbWord::run_configured(Stack& stack) {
+    auto vin = stack.pop_vector();
 
     if ( out.size() < vin->size() ) {
         out = Vec::Zero( vin->size(), 1);
     }
 
+    // nothing left to ring out, the delay lines were cleared and the input restarts a fresh reverb
+    bool silent = skip_silence_ && is_silent(*vin);
+    if ( silent && decayed ) {
+        out.setZero();
+        stack.push_vector(&out);
+        return;
+    }
+
     TNT* din = const_cast<TNT *>(vin->data());
     TNT* dout = out.data();
     dsp->compute(vin->size(), &din, &dout);
+    // the output is wet only, a quiet block right after the input says nothing about the tail
+    silence = silent ? silence + vin->size() : 0;
+    decayed = silence > LONGEST_DELAY && is_silent(out, TAIL_THRESHOLD);
+    if ( decayed ) {
+        // drop the residue below the threshold, the output no longer depends on how long the silence was
+        dsp->instanceClear();
+    }
 
     stack.push_vector(&out);
 }
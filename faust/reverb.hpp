@@ -10,16 +10,24 @@ namespace dsp {
 
 namespace lr { namespace faust {
 
-struct ReFreeverbWord : public NativeWord {
-    ReFreeverbWord() { dsp = nullptr; }
+struct ReFreeverbWord : public ConfigNativeWord {
+    // vin sr, the sample rate is configuration
+    ReFreeverbWord(bool skip_silence) : ConfigNativeWord(1), skip_silence_(skip_silence) { dsp = nullptr; silence = 0; decayed = false; }
     virtual ~ReFreeverbWord();
-    virtual void run(Stack& stack);
+    virtual void configure(std::vector<Cell>& args);
+    virtual void run_configured(Stack& stack);
 
-    NWORD_CREATOR_DEFINE_LR(ReFreeverbWord)
+    static NativeWord* creator(Enviroment& env) {
+        return new ReFreeverbWord( env.skip_silence() );
+    }
 
 private:
     dsp::ReFreeverb* dsp;
     Vec out;
+    const bool skip_silence_;
+    size_t silence;     // silent input samples in a row
+    bool decayed;       // input silent for longer than the delay lines and a tail below the threshold
+
 };
 
 }}
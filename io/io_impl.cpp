@@ -9,8 +9,9 @@
 
 namespace lr { namespace io {
 
-struct MatReader : public NativeWord {
-    MatReader() {
+struct MatReader : public ConfigNativeWord {
+    // dim file_name
+    MatReader() : ConfigNativeWord(2) {
         in_sf = nullptr;
     }
 
@@ -20,17 +21,19 @@ struct MatReader : public NativeWord {
         }
     }
 
-    virtual void run(Stack& stack) {
-        const char* file_name = stack.pop_string();
-        const int dim = stack.pop_number();
+    virtual void configure(std::vector<Cell>& args) {
+        dim_ = args[0].as_number();
+        const char* file_name = args[1].as_string();
 
-        if ( in_sf == nullptr) {
-            const int sr = 16000;
-            SF_INFO in_info = { sr, sr, dim, SF_FORMAT_MAT5 | SF_FORMAT_FLOAT | SF_ENDIAN_LITTLE, 0, 0};
-            in_sf = sf_open(file_name, SFM_READ, &in_info);
+        const int sr = 16000;
+        SF_INFO in_info = { sr, sr, dim_, SF_FORMAT_MAT5 | SF_FORMAT_FLOAT | SF_ENDIAN_LITTLE, 0, 0};
+        in_sf = sf_open(file_name, SFM_READ, &in_info);
 
-            lr_assert(in_sf != nullptr , "Can't open mat file");
-        }
+        lr_assert(in_sf != nullptr , "Can't open mat file");
+    }
+
+    virtual void run_configured(Stack& stack) {
+        const int dim = dim_;
 
         float buf[dim];
         int count = sf_read_float(in_sf, buf, dim);
@@ -48,10 +51,12 @@ struct MatReader : public NativeWord {
     NWORD_CREATOR_DEFINE_LR(MatReader)
 private:
     SNDFILE* in_sf;
+    int dim_;
 };
 
-struct WavReader : public NativeWord {
-    WavReader() {
+struct WavReader : public ConfigNativeWord {
+    // bs file_name
+    WavReader() : ConfigNativeWord(2) {
         in_sf = nullptr;
     }
 
@@ -61,22 +66,22 @@ struct WavReader : public NativeWord {
         }
     }
 
-    virtual void run(Stack& stack) {
-        const char* file_name = stack.pop_string();
-        const size_t bs = stack.pop_number();
+    virtual void configure(std::vector<Cell>& args) {
+        const size_t bs = args[0].as_number();
+        const char* file_name = args[1].as_string();
 
-        if ( in_sf == nullptr) {
-            SF_INFO in_info;
-            memset (&in_info, 0, sizeof (in_info)) ;
-            in_sf = sf_open(file_name, SFM_READ, &in_info);
+        SF_INFO in_info;
+        memset (&in_info, 0, sizeof (in_info)) ;
+        in_sf = sf_open(file_name, SFM_READ, &in_info);
 
-            lr_assert(in_sf != nullptr, "Can't open wav file");
-            lr_assert(in_info.channels == 1, "WavReader only support mono");
+        lr_assert(in_sf != nullptr, "Can't open wav file");
+        lr_assert(in_info.channels == 1, "WavReader only support mono");
 
-            vec = Vec::Zero(bs, 1);
-        }
+        vec = Vec::Zero(bs, 1);
+    }
 
-        lr_assert( vec.size() == (int)bs , "block size should be fixed");
+    virtual void run_configured(Stack& stack) {
+        const size_t bs = vec.size();
 
         float buf[bs];
         size_t count = sf_read_float(in_sf, buf, bs);
@@ -101,8 +106,9 @@ private:
     Vec vec;
 };
 
-struct WavWriter : public NativeWord {
-    WavWriter() {
+struct WavWriter : public ConfigNativeWord {
+    // value ch sr file_name
+    WavWriter(size_t bs) : ConfigNativeWord(3), block_size_(bs) {
         out_sf = nullptr;
     }
     virtual ~WavWriter() {
@@ -111,21 +117,25 @@ struct WavWriter : public NativeWord {
         }
     }
 
-    virtual void run(Stack& stack) {
-        const char* file_name = stack.pop_string();
-        int sr = stack.pop_number();
-        int ch = stack.pop_number();
+    virtual void configure(std::vector<Cell>& args) {
+        int ch = args[0].as_number();
+        int sr = args[1].as_number();
+        const char* file_name = args[2].as_string();
 
         lr_assert(ch == 1, "Current only support mono mode!");
 
-        if ( out_sf == nullptr) {
-            SF_INFO out_info = { sr, sr, ch, SF_FORMAT_WAV | SF_FORMAT_FLOAT | SF_ENDIAN_LITTLE, 0, 0};
-            out_sf = sf_open(file_name, SFM_WRITE, &out_info);
-        }
+        SF_INFO out_info = { sr, sr, ch, SF_FORMAT_WAV | SF_FORMAT_FLOAT | SF_ENDIAN_LITTLE, 0, 0};
+        out_sf = sf_open(file_name, SFM_WRITE, &out_info);
+
+        held_ = Vec::Zero(block_size_, 1);
+    }
 
+    virtual void run_configured(Stack& stack) {
+
+        // a number is a control value, held over the whole block
         if ( stack.top().is_number() ) {
-            float v = stack.pop_number();
-            sf_write_float(out_sf, &v, 1);
+            held_.setConstant( stack.pop_number() );
+            sf_write_float(out_sf, held_.data(), block_size_);
             return;
         }
 
@@ -134,13 +144,18 @@ struct WavWriter : public NativeWord {
         sf_write_float(out_sf, v->data(), s);
     }
 
-    NWORD_CREATOR_DEFINE_LR(WavWriter)
+    static NativeWord* creator(Enviroment& env) {
+        return new WavWriter( env.block_size() );
+    }
 private:
+    const size_t block_size_;
     SNDFILE* out_sf;
+    Vec held_;
 };
 
-struct MidiInWord : public NativeWord {
-    MidiInWord() {
+struct MidiInWord : public ConfigNativeWord {
+    // port
+    MidiInWord() : ConfigNativeWord(1) {
         midi_ = nullptr;
     }
     virtual ~MidiInWord() {
@@ -149,21 +164,21 @@ struct MidiInWord : public NativeWord {
         }
     }
 
-    virtual void run(Stack& stack) {
-        int port = stack.pop_number();
+    virtual void configure(std::vector<Cell>& args) {
+        int port = args[0].as_number();
 
-        if ( midi_ == nullptr) {
-            try {
-                midi_ = new RtMidiIn();
-                midi_->setCallback(&MidiInWord::midiHandler, (void*)this);
-                midi_->openPort(port);
-            }
-            catch (RtMidiError& error) {
-                error.printMessage();
-                lr_panic("Open MIDI input error!");
-            }
+        try {
+            midi_ = new RtMidiIn();
+            midi_->setCallback(&MidiInWord::midiHandler, (void*)this);
+            midi_->openPort(port);
         }
+        catch (RtMidiError& error) {
+            error.printMessage();
+            lr_panic("Open MIDI input error!");
+        }
+    }
 
+    virtual void run_configured(Stack& stack) {
         MidiMessage msg = MidiMessage::null();
         pop_message(msg);
         stack.push_number(msg.value_);
@@ -220,12 +235,25 @@ void MidiInWord::midiHandler(double timeStamp, std::vector<unsigned char>* bytes
     wd->push_message(msg);
 }
 
+// a bound mat reader pushes one number per row
+static std::vector<WordSignature> mat_signature(const std::vector<Cell>& args) {
+    Cell dim = args[0];
+    if ( !dim.is_number() || dim.num() < 0 ) {
+        return {};
+    }
+    std::string effect = "--";
+    for (int i = 0; i < (int)dim.num(); i++) {
+        effect += " n";
+    }
+    return { WordSignature(effect.c_str()) };
+}
+
 void init_words(Enviroment& env) {
-    env.insert_native_word("io.write_wav", WavWriter::creator);
-    env.insert_native_word("io.read_mat", MatReader::creator);
-    env.insert_native_word("io.read_wav", WavReader::creator);
+    env.insert_native_word("io.write_wav", WavWriter::creator, {"n n n s --", "v n n s --"});
+    env.insert_native_word("io.read_mat", MatReader::creator, mat_signature);
+    env.insert_native_word("io.read_wav", WavReader::creator, {"n s -- v"});
 
-    env.insert_native_word("io.midi_in", MidiInWord::creator);
+    env.insert_native_word("io.midi_in", MidiInWord::creator, {"n -- n"});
 }
 
 }}
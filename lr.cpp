@@ -1,14 +1,17 @@
+#include <fstream>
+
 #include "lr.hpp"
+#include "fastmath.hpp"
 
 namespace lr {
 
 std::ostream& operator<<(std::ostream& os, const Cell& c) {
-    if ( c.type_ == Cell::T_String ) {
-        os << "S:" << c.v._str;
-    } else if ( c.type_ == Cell::T_Number ) {
-        os << "N:" << c.v._num;
+    if ( c.type() == Cell::T_String ) {
+        os << "S:" << c.str();
+    } else if ( c.type() == Cell::T_Number ) {
+        os << "N:" << c.num();
     } else {
-        os << "V: (" << std::endl << *(c.v._vec) << " )";
+        os << "V: (" << std::endl << *(c.vec()) << " )";
     }
     return os;
 }
@@ -22,6 +25,10 @@ std::ostream& operator<<(std::ostream& os, const WordCode& c) {
         os << "B:" << c.str_;
     } else if ( c.type_ == WordCode::Native ) {
         os << "NA:" << c.str_;
+    } else if ( c.type_ == WordCode::Loop ) {
+        os << "L:" << c.str_ << " " << c.num_;
+    } else if ( c.type_ == WordCode::LoopEnd ) {
+        os << "LE:" << c.str_ << " " << c.num_;
     } else {
         os << "U:" << c.str_;
     }
@@ -30,7 +37,7 @@ std::ostream& operator<<(std::ostream& os, const WordCode& c) {
 
 std::ostream& operator<<(std::ostream& os, Stack& stack) {
     os << "----STACK(" << stack.size() << ")----" << std::endl;
-    for (size_t i = 0; i < stack.data_.size(); i++) {
+    for (size_t i = 0; i < stack.size(); i++) {
         os << "==>" << i << " " << stack.data_[i] << std::endl;
     }
     os << "----" << std::endl;
@@ -87,6 +94,31 @@ namespace base {
         NWORD_CREATOR_DEFINE_LR(Rot)
     };
 
+    // unchecked stack words for verified programs
+    struct DropFast : public NativeWord {
+        virtual void run(Stack& stack) {
+            stack.raw_pop();
+        }
+        NWORD_CREATOR_DEFINE_LR(DropFast)
+    };
+
+    struct DupFast : public NativeWord {
+        virtual void run(Stack& stack) {
+            stack.raw_push( stack.raw_top() );
+        }
+        NWORD_CREATOR_DEFINE_LR(DupFast)
+    };
+
+    struct SwapFast : public NativeWord {
+        virtual void run(Stack& stack) {
+            auto a = stack.raw_pop();
+            auto b = stack.raw_pop();
+            stack.raw_push(a);
+            stack.raw_push(b);
+        }
+        NWORD_CREATOR_DEFINE_LR(SwapFast)
+    };
+
     struct OnlyOnce : public StaticNativeWord {
         virtual void run_first(Stack& stack) {
             return;
@@ -94,6 +126,10 @@ namespace base {
         virtual void run_next(Stack& stack) {
             stack.drop();
         }
+        virtual bool steady(size_t& args, std::vector<Cell>& outs) {
+            args = 1;
+            return true;
+        }
         NWORD_CREATOR_DEFINE_LR(OnlyOnce)
     };
 
@@ -107,6 +143,11 @@ namespace base {
             stack.pop_number();
             stack.push_vector( &vec);
         }
+        virtual bool steady(size_t& args, std::vector<Cell>& outs) {
+            args = 1;
+            outs.push_back( Cell(&vec) );
+            return true;
+        }
         NWORD_CREATOR_DEFINE_LR(Zeros)
     private:
         Vec vec;
@@ -122,6 +163,11 @@ namespace base {
             stack.pop_number();
             stack.push_vector( &vec);
         }
+        virtual bool steady(size_t& args, std::vector<Cell>& outs) {
+            args = 1;
+            outs.push_back( Cell(&vec) );
+            return true;
+        }
         NWORD_CREATOR_DEFINE_LR(Ones)
     private:
         Vec vec;
@@ -139,6 +185,11 @@ namespace base {
             stack.pop_number();
             stack.push_vector( &vec);
         }
+        virtual bool steady(size_t& args, std::vector<Cell>& outs) {
+            args = 2;
+            outs.push_back( Cell(&vec) );
+            return true;
+        }
         NWORD_CREATOR_DEFINE_LR(Numbers)
     private:
         Vec vec;
@@ -154,6 +205,11 @@ namespace base {
             stack.pop_number();
             stack.push_vector( &vec);
         }
+        virtual bool steady(size_t& args, std::vector<Cell>& outs) {
+            args = 1;
+            outs.push_back( Cell(&vec) );
+            return true;
+        }
         NWORD_CREATOR_DEFINE_LR(Randoms)
     private:
         Vec vec;
@@ -167,9 +223,15 @@ namespace base {
             stack.push_vector( &vec);
         }
         virtual void run_next(Stack& stack) {
+            stack.pop_number();
             stack.pop_number();
             stack.push_vector( &vec);
         }
+        virtual bool steady(size_t& args, std::vector<Cell>& outs) {
+            args = 2;
+            outs.push_back( Cell(&vec) );
+            return true;
+        }
         NWORD_CREATOR_DEFINE_LR(Matrix)
     private:
         Vec vec;
@@ -205,8 +267,69 @@ struct CLS : public NativeWord {                    \
          NativeWord* wd = new CLS();                \
          return wd;                                 \
     }                                               \
+    static void kernel(TNT* out, ElementArg a, ElementArg b, size_t n) { \
+        const TNT* x = a.data_;                     \
+        const TNT* y = b.data_;                     \
+        if ( a.scalar_ && b.scalar_ ) {             \
+            TNT v = x[0] op y[0];                   \
+            for (size_t i = 0; i < n; i++) {        \
+                out[i] = v;                         \
+            }                                       \
+        } else if ( a.scalar_ ) {                   \
+            TNT v = x[0];                           \
+            for (size_t i = 0; i < n; i++) {        \
+                out[i] = v op y[i];                 \
+            }                                       \
+        } else if ( b.scalar_ ) {                   \
+            TNT v = y[0];                           \
+            for (size_t i = 0; i < n; i++) {        \
+                out[i] = x[i] op v;                 \
+            }                                       \
+        } else {                                    \
+            for (size_t i = 0; i < n; i++) {        \
+                out[i] = x[i] op y[i];              \
+            }                                       \
+        }                                           \
+    }                                               \
 private:                                            \
     Vec result;                                     \
+};                                                  \
+struct CLS##NN : public RegisterWord {              \
+    virtual void run(Stack& stack) {                \
+        auto a = stack.raw_pop().num();             \
+        auto b = stack.raw_pop().num();             \
+        stack.raw_push( Cell(a op b) );             \
+    }                                               \
+    virtual void run(Cell* regs, const size_t* args) { \
+        regs[args[2]] = Cell( regs[args[1]].num() op regs[args[0]].num() ); \
+    }                                               \
+    NWORD_CREATOR_DEFINE_LR(CLS##NN)                \
+};                                                  \
+struct CLS##NV : public RegisterWord {              \
+    virtual void run(Stack& stack) {                \
+        auto a = stack.raw_pop().vec();             \
+        auto b = stack.raw_pop().num();             \
+        *out_ = *a op b;                            \
+        stack.raw_push( Cell(out_) );               \
+    }                                               \
+    virtual void run(Cell* regs, const size_t* args) { \
+        *out_ = *regs[args[1]].vec() op regs[args[0]].num(); \
+        regs[args[2]] = Cell(out_);                 \
+    }                                               \
+    NWORD_CREATOR_DEFINE_LR(CLS##NV)                \
+};                                                  \
+struct CLS##VV : public RegisterWord {              \
+    virtual void run(Stack& stack) {                \
+        auto a = stack.raw_pop().vec();             \
+        auto b = stack.raw_pop().vec();             \
+        *out_ = *a op *b;                           \
+        stack.raw_push( Cell(out_) );               \
+    }                                               \
+    virtual void run(Cell* regs, const size_t* args) { \
+        *out_ = *regs[args[1]].vec() op *regs[args[0]].vec(); \
+        regs[args[2]] = Cell(out_);                 \
+    }                                               \
+    NWORD_CREATOR_DEFINE_LR(CLS##VV)                \
 }
 
 #define UNI_MATH_WORD_LR(CLS, op)                 \
@@ -219,6 +342,7 @@ struct CLS : public NativeWord {                    \
         } else if ( stack.top().is_vector() ) {     \
             auto a = stack.pop_vector();            \
             result = a->op();                       \
+            stack.push_vector(&result);             \
             return;                                 \
         }                                           \
         lr_panic("#CLS don't support type!");     \
@@ -227,10 +351,135 @@ struct CLS : public NativeWord {                    \
          NativeWord* wd = new CLS();                \
          return wd;                                 \
     }                                               \
+    static void kernel(TNT* out, ElementArg a, ElementArg b, size_t n) { \
+        Eigen::Map<Eigen::ArrayXf> o(out, n);       \
+        if ( a.scalar_ ) {                          \
+            o.setConstant( std::op(a.data_[0]) );   \
+        } else {                                    \
+            o = Eigen::Map<const Eigen::ArrayXf>(a.data_, n).op(); \
+        }                                           \
+    }                                               \
+private:                                            \
+    Vec result;                                     \
+};                                                  \
+struct CLS##N : public RegisterWord {               \
+    virtual void run(Stack& stack) {                \
+        Cell& a = stack.raw_top();                  \
+        a = Cell( (TNT)std::op(a.num()) );          \
+    }                                               \
+    virtual void run(Cell* regs, const size_t* args) { \
+        regs[args[1]] = Cell( (TNT)std::op(regs[args[0]].num()) ); \
+    }                                               \
+    NWORD_CREATOR_DEFINE_LR(CLS##N)                 \
+};                                                  \
+struct CLS##V : public RegisterWord {               \
+    virtual void run(Stack& stack) {                \
+        Cell& a = stack.raw_top();                  \
+        *out_ = a.vec()->op();                      \
+        a = Cell(out_);                             \
+    }                                               \
+    virtual void run(Cell* regs, const size_t* args) { \
+        *out_ = regs[args[0]].vec()->op();          \
+        regs[args[1]] = Cell(out_);                 \
+    }                                               \
+    NWORD_CREATOR_DEFINE_LR(CLS##V)                 \
+}
+
+// a math word with an approximated version, creators pick one by the "FastMath" setting
+#define UNI_FAST_MATH_WORD_LR(CLS, op)            \
+UNI_MATH_WORD_LR(CLS, op);                          \
+struct CLS##Fast : public NativeWord {              \
+    virtual void run(Stack& stack) {                \
+        if ( stack.top().is_number() ) {            \
+            auto a = stack.pop_number();            \
+            stack.push_number( fastmath::op(a) );   \
+            return;                                 \
+        } else if ( stack.top().is_vector() ) {     \
+            auto a = stack.pop_vector();            \
+            result.resize(a->rows(), a->cols());    \
+            fastmath::op(a->data(), result.data(), a->size()); \
+            stack.push_vector(&result);             \
+            return;                                 \
+        }                                           \
+        lr_panic("#CLS don't support type!");     \
+    }                                               \
+    static NativeWord* creator(Enviroment& env) {   \
+        if ( env.fast_math() ) {                    \
+            return new CLS##Fast();                 \
+        }                                           \
+        return new CLS();                           \
+    }                                               \
+    static void kernel(TNT* out, ElementArg a, ElementArg b, size_t n) { \
+        if ( a.scalar_ ) {                          \
+            TNT v = fastmath::op(a.data_[0]);       \
+            for (size_t i = 0; i < n; i++) {        \
+                out[i] = v;                         \
+            }                                       \
+        } else {                                    \
+            fastmath::op(a.data_, out, n);          \
+        }                                           \
+    }                                               \
 private:                                            \
     Vec result;                                     \
+};                                                  \
+struct CLS##FastN : public RegisterWord {           \
+    virtual void run(Stack& stack) {                \
+        Cell& a = stack.raw_top();                  \
+        a = Cell( fastmath::op(a.num()) );          \
+    }                                               \
+    virtual void run(Cell* regs, const size_t* args) { \
+        regs[args[1]] = Cell( fastmath::op(regs[args[0]].num()) ); \
+    }                                               \
+    static NativeWord* creator(Enviroment& env) {   \
+        if ( env.fast_math() ) {                    \
+            return new CLS##FastN();                \
+        }                                           \
+        return new CLS##N();                        \
+    }                                               \
+};                                                  \
+struct CLS##FastV : public RegisterWord {           \
+    virtual void run(Stack& stack) {                \
+        Cell& a = stack.raw_top();                  \
+        const Vec* v = a.vec();                     \
+        out_->resize(v->rows(), v->cols());         \
+        fastmath::op(v->data(), out_->data(), v->size()); \
+        a = Cell(out_);                             \
+    }                                               \
+    virtual void run(Cell* regs, const size_t* args) { \
+        const Vec* v = regs[args[0]].vec();         \
+        out_->resize(v->rows(), v->cols());         \
+        fastmath::op(v->data(), out_->data(), v->size()); \
+        regs[args[1]] = Cell(out_);                 \
+    }                                               \
+    static NativeWord* creator(Enviroment& env) {   \
+        if ( env.fast_math() ) {                    \
+            return new CLS##FastV();                \
+        }                                           \
+        return new CLS##V();                        \
+    }                                               \
 }
 
+// registering a math word with its checked and unchecked implementations,
+// a number applied to a vector is a control value
+#define BIN_OP_MATH_INSERT_LR(name, CLS)                        \
+    insert_pure_word(name, CLS::creator,                        \
+                       { {"n n -- n", CLS##NN::creator},        \
+                         {"n v -- v", CLS##NV::creator, "c ."}, \
+                         {"v v -- v", CLS##VV::creator} });     \
+    insert_element_kernel(name, CLS::kernel)
+
+#define UNI_MATH_INSERT_LR(name, CLS)                           \
+    insert_pure_word(name, CLS::creator,                        \
+                       { {"n -- n", CLS##N::creator},           \
+                         {"v -- v", CLS##V::creator} });        \
+    insert_element_kernel(name, CLS::kernel)
+
+#define UNI_FAST_MATH_INSERT_LR(name, CLS)                      \
+    insert_pure_word(name, CLS##Fast::creator,                  \
+                       { {"n -- n", CLS##FastN::creator},       \
+                         {"v -- v", CLS##FastV::creator} });    \
+    insert_element_kernel(name, CLS::kernel, CLS##Fast::kernel)
+
 
 namespace math {
     BIN_OP_MATH_WORD_LR(Add, +);
@@ -240,14 +489,14 @@ namespace math {
 
     UNI_MATH_WORD_LR(Abs, abs);
     UNI_MATH_WORD_LR(Arg, arg);
-    UNI_MATH_WORD_LR(Exp, exp);
-    UNI_MATH_WORD_LR(Log, log);
+    UNI_FAST_MATH_WORD_LR(Exp, exp);
+    UNI_FAST_MATH_WORD_LR(Log, log);
     UNI_MATH_WORD_LR(Log1p, log1p);
     UNI_MATH_WORD_LR(Log10, log10);
     UNI_MATH_WORD_LR(Sqrt, sqrt);
 
-    UNI_MATH_WORD_LR(Sin, sin);
-    UNI_MATH_WORD_LR(Cos, cos);
+    UNI_FAST_MATH_WORD_LR(Sin, sin);
+    UNI_FAST_MATH_WORD_LR(Cos, cos);
     UNI_MATH_WORD_LR(Tan, tan);
     UNI_MATH_WORD_LR(Asin, asin);
     UNI_MATH_WORD_LR(Acos, acos);
@@ -255,7 +504,7 @@ namespace math {
 
     UNI_MATH_WORD_LR(Sinh, sinh);
     UNI_MATH_WORD_LR(Cosh, cosh);
-    UNI_MATH_WORD_LR(Tanh, tanh);
+    UNI_FAST_MATH_WORD_LR(Tanh, tanh);
     UNI_MATH_WORD_LR(Asinh, asinh);
     UNI_MATH_WORD_LR(Acosh, acosh);
     UNI_MATH_WORD_LR(Atanh, atanh);
@@ -273,6 +522,18 @@ namespace math {
         NWORD_CREATOR_DEFINE_LR(Mod)
     };
 
+    struct ModNN : public RegisterWord {
+        virtual void run(Stack& stack) {
+            auto a = stack.raw_pop().num();
+            auto b = stack.raw_pop().num();
+            stack.raw_push( Cell( fmod(a, b) ) );
+        }
+        virtual void run(Cell* regs, const size_t* args) {
+            regs[args[2]] = Cell( fmod(regs[args[1]].num(), regs[args[0]].num()) );
+        }
+        NWORD_CREATOR_DEFINE_LR(ModNN)
+    };
+
     struct Inv : public NativeWord {
         virtual void run(Stack& stack) {
             if ( stack.top().is_number() ) {
@@ -285,9 +546,39 @@ namespace math {
             stack.push_vector(&result);
         }
         NWORD_CREATOR_DEFINE_LR(Inv);
+        static void kernel(TNT* out, ElementArg a, ElementArg b, size_t n) {
+            Eigen::Map<Eigen::ArrayXf> o(out, n);
+            if ( a.scalar_ ) {
+                o.setConstant( 1.0 / a.data_[0] );
+            } else {
+                o = Eigen::Map<const Eigen::ArrayXf>(a.data_, n).inverse();
+            }
+        }
     private:
         Vec result;
     };
+    struct InvN : public RegisterWord {
+        virtual void run(Stack& stack) {
+            Cell& a = stack.raw_top();
+            a = Cell( (TNT)(1.0 / a.num()) );
+        }
+        virtual void run(Cell* regs, const size_t* args) {
+            regs[args[1]] = Cell( (TNT)(1.0 / regs[args[0]].num()) );
+        }
+        NWORD_CREATOR_DEFINE_LR(InvN)
+    };
+    struct InvV : public RegisterWord {
+        virtual void run(Stack& stack) {
+            Cell& a = stack.raw_top();
+            *out_ = a.vec()->inverse();
+            a = Cell(out_);
+        }
+        virtual void run(Cell* regs, const size_t* args) {
+            *out_ = regs[args[0]].vec()->inverse();
+            regs[args[1]] = Cell(out_);
+        }
+        NWORD_CREATOR_DEFINE_LR(InvV)
+    };
 
     struct Pow : public NativeWord {
         virtual void run(Stack& stack) {
@@ -303,6 +594,20 @@ namespace math {
             stack.push_vector(&result);
         }
         NWORD_CREATOR_DEFINE_LR(Pow)
+        static void kernel(TNT* out, ElementArg a, ElementArg b, size_t n) {
+            Eigen::Map<Eigen::ArrayXf> o(out, n);
+            TNT x = a.data_[0];
+            TNT y = b.data_[0];
+            if ( a.scalar_ && b.scalar_ ) {
+                o.setConstant( std::pow(x, y) );
+            } else if ( a.scalar_ ) {
+                o = Eigen::Map<const Eigen::ArrayXf>(b.data_, n).unaryExpr([x](TNT v) { return std::pow(x, v); });
+            } else if ( b.scalar_ ) {
+                o = Eigen::Map<const Eigen::ArrayXf>(a.data_, n).pow(y);
+            } else {
+                o = Eigen::Map<const Eigen::ArrayXf>(a.data_, n).pow( Eigen::Map<const Eigen::ArrayXf>(b.data_, n) );
+            }
+        }
     private:
         Vec result;
     };
@@ -320,61 +625,188 @@ namespace math {
         }
         NWORD_CREATOR_DEFINE_LR(E);
     };
+
+    // sine from a 4096 points table, only for wrapped phases ( see fastmath.hpp and block.phase )
+    struct SinTable : public NativeWord {
+        virtual void run(Stack& stack) {
+            if ( stack.top().is_number() ) {
+                auto a = stack.pop_number();
+                stack.push_number( fastmath::sin_table(a) );
+                return;
+            }
+            auto a = stack.pop_vector();
+            result.resize(a->rows(), a->cols());
+            fastmath::sin_table(a->data(), result.data(), a->size());
+            stack.push_vector(&result);
+        }
+        NWORD_CREATOR_DEFINE_LR(SinTable)
+        static void kernel(TNT* out, ElementArg a, ElementArg b, size_t n) {
+            if ( a.scalar_ ) {
+                TNT v = fastmath::sin_table(a.data_[0]);
+                for (size_t i = 0; i < n; i++) {
+                    out[i] = v;
+                }
+            } else {
+                fastmath::sin_table(a.data_, out, n);
+            }
+        }
+    private:
+        Vec result;
+    };
+    struct SinTableN : public RegisterWord {
+        virtual void run(Stack& stack) {
+            Cell& a = stack.raw_top();
+            a = Cell( fastmath::sin_table(a.num()) );
+        }
+        virtual void run(Cell* regs, const size_t* args) {
+            regs[args[1]] = Cell( fastmath::sin_table(regs[args[0]].num()) );
+        }
+        NWORD_CREATOR_DEFINE_LR(SinTableN)
+    };
+    struct SinTableV : public RegisterWord {
+        virtual void run(Stack& stack) {
+            Cell& a = stack.raw_top();
+            const Vec* v = a.vec();
+            out_->resize(v->rows(), v->cols());
+            fastmath::sin_table(v->data(), out_->data(), v->size());
+            a = Cell(out_);
+        }
+        virtual void run(Cell* regs, const size_t* args) {
+            const Vec* v = regs[args[0]].vec();
+            out_->resize(v->rows(), v->cols());
+            fastmath::sin_table(v->data(), out_->data(), v->size());
+            regs[args[1]] = Cell(out_);
+        }
+        NWORD_CREATOR_DEFINE_LR(SinTableV)
+    };
+}
+
+// block words turn control values ( numbers ) into audio blocks of "BlockSize" samples
+namespace block {
+    // phase of an oscillator wrapped into [0, 2pi), input is the angular increment per sample
+    struct Phase : public NativeWord {
+        Phase(size_t bs) {
+            phase_ = 0.0;
+            vec = Vec::Zero(bs, 1);
+        }
+        virtual void run(Stack& stack) {
+            const double inc = stack.pop_number();
+            const double period = 2.0 * M_PI;
+
+            TNT* d = vec.data();
+            for (int i = 0; i < vec.size(); i++) {
+                d[i] = phase_;
+                phase_ = phase_ + inc;
+                if ( phase_ >= period || phase_ < 0.0 ) {
+                    phase_ = phase_ - std::floor(phase_ / period) * period;
+                }
+            }
+            stack.push_vector( &vec);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            return new Phase( env.block_size() );
+        }
+    private:
+        double phase_;
+        Vec vec;
+    };
+
+    // linear ramp from the last control value to the new one, avoiding zipper noise
+    struct Line : public NativeWord {
+        Line(size_t bs) {
+            first_ = true;
+            vec = Vec::Zero(bs, 1);
+        }
+        virtual void run(Stack& stack) {
+            TNT target = stack.pop_number();
+            if ( first_ ) {
+                first_ = false;
+                last_ = target;
+            }
+
+            TNT step = (target - last_) / vec.size();
+            TNT* d = vec.data();
+            for (int i = 0; i < vec.size(); i++) {
+                d[i] = last_ + step * (i + 1);
+            }
+            last_ = target;
+            stack.push_vector( &vec);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            return new Line( env.block_size() );
+        }
+    private:
+        bool first_;
+        TNT last_;
+        Vec vec;
+    };
 }
 
 void Enviroment::load_base_math() {
     // base words
-    insert_native_word("drop", base::Drop::creator );
-    insert_native_word("dup", base::Dup::creator );
-    insert_native_word("dup2", base::Dup2::creator );
-    insert_native_word("swap", base::Swap::creator );
-    insert_native_word("rot", base::Rot::creator );
+    insert_pure_word("drop", base::Drop::creator, { {"a --", base::DropFast::creator} } );
+    insert_pure_word("dup", base::Dup::creator, { {"a -- a a", base::DupFast::creator} } );
+    insert_pure_word("dup2", base::Dup2::creator, {"a b -- a b a b a b"} );
+    insert_pure_word("swap", base::Swap::creator, { {"a b -- b a", base::SwapFast::creator} } );
+    insert_pure_word("rot", base::Rot::creator, {"a b c -- b c a"} );
     insert_native_word("~", base::OnlyOnce::creator);
-    insert_native_word("?", base::Dump::creator );
-    insert_native_word("^", base::Exit::creator );
+    insert_native_word("?", base::Dump::creator, {"--"} );
+    insert_native_word("^", base::Exit::creator, {"--"} );
+
+    insert_native_word("zeros~", base::Zeros::creator, {"n -- v"} );
+    insert_native_word("ones~", base::Ones::creator, {"n -- v"} );
+    insert_native_word("numbers~", base::Numbers::creator, {"n n -- v"} );
+    insert_native_word("randoms~", base::Randoms::creator, {"n -- v"} );
+    insert_native_word("matrix~", base::Matrix::creator, {"n n -- v"} );
 
-    insert_native_word("zeros~", base::Zeros::creator );
-    insert_native_word("ones~", base::Ones::creator );
-    insert_native_word("numbers~", base::Numbers::creator );
-    insert_native_word("randoms~", base::Randoms::creator );
-    insert_native_word("matrix~", base::Matrix::creator );
+    // block words
+    insert_native_word("block.phase", block::Phase::creator, {"n -- v"} );
+    insert_native_word("block.line", block::Line::creator, {"n -- v"} );
 
     // math words
-    insert_native_word("+", math::Add::creator );
-    insert_native_word("-", math::Sub::creator );
-    insert_native_word("*", math::Mul::creator );
-    insert_native_word("/", math::Div::creator );
-    insert_native_word("%", math::Mod::creator );
-
-    insert_native_word("abs", math::Abs::creator );
-    insert_native_word("arg", math::Arg::creator );
-    insert_native_word("exp", math::Exp::creator );
-    insert_native_word("inv", math::Inv::creator );
-    insert_native_word("log", math::Log::creator );
-    insert_native_word("log1p", math::Log1p::creator );
-    insert_native_word("log10", math::Log10::creator );
-    insert_native_word("pow", math::Pow::creator );
-
-    insert_native_word("sin", math::Sin::creator );
-    insert_native_word("cos", math::Cos::creator );
-    insert_native_word("tan", math::Tan::creator );
-    insert_native_word("asin", math::Asin::creator );
-    insert_native_word("acos", math::Acos::creator );
-    insert_native_word("atan", math::Atan::creator );
-
-    insert_native_word("sinh", math::Sinh::creator );
-    insert_native_word("cosh", math::Cosh::creator );
-    insert_native_word("tanh", math::Tanh::creator );
-    insert_native_word("asinh", math::Asinh::creator );
-    insert_native_word("acosh", math::Acosh::creator );
-    insert_native_word("atanh", math::Atanh::creator );
-
-    insert_native_word("ceil", math::Ceil::creator );
-    insert_native_word("floor", math::Floor::creator );
-    insert_native_word("round", math::Round::creator );
-
-    insert_native_word("math.pi", math::PI::creator );
-    insert_native_word("math.e", math::E::creator );
+    BIN_OP_MATH_INSERT_LR("+", math::Add);
+    BIN_OP_MATH_INSERT_LR("-", math::Sub);
+    BIN_OP_MATH_INSERT_LR("*", math::Mul);
+    BIN_OP_MATH_INSERT_LR("/", math::Div);
+    insert_pure_word("%", math::Mod::creator, { {"n n -- n", math::ModNN::creator} } );
+
+    UNI_MATH_INSERT_LR("abs", math::Abs);
+    UNI_MATH_INSERT_LR("arg", math::Arg);
+    UNI_FAST_MATH_INSERT_LR("exp", math::Exp);
+    insert_pure_word("inv", math::Inv::creator,
+                       { {"n -- n", math::InvN::creator},
+                         {"v -- v", math::InvV::creator} });
+    insert_element_kernel("inv", math::Inv::kernel);
+    UNI_FAST_MATH_INSERT_LR("log", math::Log);
+    UNI_MATH_INSERT_LR("log1p", math::Log1p);
+    UNI_MATH_INSERT_LR("log10", math::Log10);
+    insert_pure_word("pow", math::Pow::creator, {"n n -- n", "v v -- v"} );
+    insert_element_kernel("pow", math::Pow::kernel);
+
+    UNI_FAST_MATH_INSERT_LR("sin", math::Sin);
+    UNI_FAST_MATH_INSERT_LR("cos", math::Cos);
+    UNI_MATH_INSERT_LR("tan", math::Tan);
+    UNI_MATH_INSERT_LR("asin", math::Asin);
+    UNI_MATH_INSERT_LR("acos", math::Acos);
+    UNI_MATH_INSERT_LR("atan", math::Atan);
+
+    UNI_MATH_INSERT_LR("sinh", math::Sinh);
+    UNI_MATH_INSERT_LR("cosh", math::Cosh);
+    UNI_FAST_MATH_INSERT_LR("tanh", math::Tanh);
+    UNI_MATH_INSERT_LR("asinh", math::Asinh);
+    UNI_MATH_INSERT_LR("acosh", math::Acosh);
+    UNI_MATH_INSERT_LR("atanh", math::Atanh);
+
+    UNI_MATH_INSERT_LR("ceil", math::Ceil);
+    UNI_MATH_INSERT_LR("floor", math::Floor);
+    UNI_MATH_INSERT_LR("round", math::Round);
+
+    insert_pure_word("math.pi", math::PI::creator, {"-- n"} );
+    insert_pure_word("math.e", math::E::creator, {"-- n"} );
+    insert_pure_word("math.sin_table", math::SinTable::creator,
+                       { {"n -- n", math::SinTableN::creator},
+                         {"v -- v", math::SinTableV::creator} });
+    insert_element_kernel("math.sin_table", math::SinTable::kernel);
 }
 
 Runtime Enviroment::build(const std::string& txt) {
@@ -383,5 +815,153 @@ Runtime Enviroment::build(const std::string& txt) {
     return rt;
 }
 
+Runtime Enviroment::build(const std::string& txt, const std::string& cache) {
+    uint64_t key = cache_key(txt);
+    UserWord main_code;
+    if ( load_cache(cache, key, main_code) == false ) {
+        std::set<std::string> known;
+        for (auto& m : user_words_) {
+            known.insert(m.first);
+        }
+        size_t loops = loops_;
+        main_code = compile(txt);
+        save_cache(cache, key, loops, known, main_code);
+    }
+    Runtime rt(*this, main_code);
+    return rt;
+}
+
+// .lrc files: a header ( magic, key, hidden loop names ), user words defined by the source, main code
+namespace cache {
+    const char magic[] = "LRC1";
+
+    // FNV-1a
+    uint64_t hash(uint64_t h, const char* data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ (unsigned char)data[i]) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    void write_size(std::ostream& os, uint64_t v) {
+        os.write( (const char*)&v, sizeof(v) );
+    }
+    void write_string(std::ostream& os, const std::string& str) {
+        write_size(os, str.size());
+        os.write( str.data(), str.size() );
+    }
+    void write_word(std::ostream& os, const UserWord& word) {
+        write_size(os, word.size());
+        for (auto& code : word) {
+            write_size(os, code.type_);
+            write_string(os, code.str_);
+            os.write( (const char*)&code.num_, sizeof(code.num_) );
+        }
+    }
+
+    bool read_size(std::istream& is, uint64_t& v) {
+        return (bool)is.read( (char*)&v, sizeof(v) );
+    }
+    bool read_string(std::istream& is, std::string& str) {
+        uint64_t len;
+        if ( !read_size(is, len) ) {
+            return false;
+        }
+        str.resize(len);
+        return (bool)is.read( str.data(), len );
+    }
+    bool read_word(std::istream& is, UserWord& word) {
+        uint64_t n;
+        if ( !read_size(is, n) ) {
+            return false;
+        }
+        word.resize(n);
+        for (auto& code : word) {
+            uint64_t type;
+            if ( !read_size(is, type) || type > WordCode::LoopEnd ) {
+                return false;
+            }
+            code.type_ = (decltype(code.type_))type;
+            if ( !read_string(is, code.str_) || !is.read( (char*)&code.num_, sizeof(code.num_) ) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+uint64_t Enviroment::cache_key(const std::string& txt) {
+    uint64_t h = cache::hash(14695981039346656037ull, txt.data(), txt.size());
+    for (auto& m : native_words_) {
+        h = cache::hash(h, m.first.c_str(), m.first.size() + 1);
+    }
+    // the source compiles against the user words defined before it
+    for (auto& m : user_words_) {
+        h = cache::hash(h, m.first.c_str(), m.first.size() + 1);
+        for (auto& code : m.second) {
+            uint64_t type = code.type_;
+            h = cache::hash(h, (const char*)&type, sizeof(type));
+            h = cache::hash(h, code.str_.c_str(), code.str_.size() + 1);
+            h = cache::hash(h, (const char*)&code.num_, sizeof(code.num_));
+        }
+    }
+    return h;
+}
+
+bool Enviroment::load_cache(const std::string& file, uint64_t key, UserWord& main_code) {
+    std::ifstream is(file, std::ios::binary);
+    char magic[4];
+    if ( !is.read(magic, 4) || memcmp(magic, cache::magic, 4) != 0 ) {
+        return false;
+    }
+    uint64_t k, begin, end, n;
+    if ( !cache::read_size(is, k) || k != key ) {
+        return false;
+    }
+    if ( !cache::read_size(is, begin) || !cache::read_size(is, end) || begin != loops_ ) {
+        return false;
+    }
+
+    std::map<std::string, UserWord> words;
+    if ( !cache::read_size(is, n) ) {
+        return false;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        std::string name;
+        UserWord word;
+        if ( !cache::read_string(is, name) || !cache::read_word(is, word) ) {
+            return false;
+        }
+        if ( user_words_.find(name) != user_words_.end() ) {
+            return false;
+        }
+        words[name] = word;
+    }
+    if ( !cache::read_word(is, main_code) ) {
+        return false;
+    }
+
+    user_words_.insert(words.begin(), words.end());
+    loops_ = end;
+    return true;
+}
+
+void Enviroment::save_cache(const std::string& file, uint64_t key, size_t loops, const std::set<std::string>& known, const UserWord& main_code) {
+    std::ofstream os(file, std::ios::binary);
+    os.write(cache::magic, 4);
+    cache::write_size(os, key);
+    cache::write_size(os, loops);
+    cache::write_size(os, loops_);
+
+    cache::write_size(os, user_words_.size() - known.size());
+    for (auto& m : user_words_) {
+        if ( known.find(m.first) == known.end() ) {
+            cache::write_string(os, m.first);
+            cache::write_word(os, m.second);
+        }
+    }
+    cache::write_word(os, main_code);
+}
+
 
 }
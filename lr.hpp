@@ -4,13 +4,27 @@
 #define _LOTUS_RIVER_H_
 
 #include <map>
+#include <set>
+#include <deque>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <unordered_map>
 #include <vector>
 #include <variant>
 #include <optional>
+#include <typeinfo>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <iostream>
+#include <sstream>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <Eigen/Dense>
 
 // gloal help functions
@@ -29,6 +43,14 @@ inline void lr__M_Assert(const char* expr_str, bool expr, const char* file, int
     }
 }
 
+// per cell and per stack operation checks, compiled out with LR_UNCHECKED.
+// Verified programs skip the stack checks anyway, they run with unchecked literals, variables and natives
+#ifdef LR_UNCHECKED
+#define lr_check(Expr, Msg)
+#else
+#define lr_check(Expr, Msg) lr_assert(Expr, Msg)
+#endif
+
 inline void lr__M_Panic(const char* file, int line, const char* msg) {
     std::cerr << "Assert failed:\t" << msg << "\n"
         << "Source:\t\t" << file << ", line " << line << "\n";
@@ -42,13 +64,59 @@ namespace lr {
 using Vec = Eigen::Array<float, Eigen::Dynamic, Eigen::Dynamic>;
 using TNT = float;
 
+#ifdef LR_COMPACT_CELL
+// 8 bytes cell: tag in the high 16 bits, float bits or 48 bits pointer below
+struct Cell {
+    enum CellType {
+        T_Number,
+        T_String,
+        T_Vector,
+    };
+    static_assert(sizeof(void*) == 8 && sizeof(TNT) == 4, "compact cell needs 64 bits pointer and float number");
+    static const uint64_t PAYLOAD_MASK = (1ull << 48) - 1;
+
+    uint64_t bits_;
+
+    // constructors
+    Cell() {
+        bits_ = 0;
+    }
+    Cell(TNT value) {
+        uint32_t b;
+        memcpy(&b, &value, sizeof(b));
+        bits_ = b;
+    }
+    Cell(const char* str) {
+        bits_ = ((uint64_t)T_String << 48) | ((uint64_t)(uintptr_t)str & PAYLOAD_MASK);
+    }
+    Cell(Vec* vec) {
+        bits_ = ((uint64_t)T_Vector << 48) | ((uint64_t)(uintptr_t)vec & PAYLOAD_MASK);
+    }
+
+    // unchecked access
+    CellType type() const {
+        return (CellType)(bits_ >> 48);
+    }
+    TNT num() const {
+        uint32_t b = (uint32_t)bits_;
+        TNT value;
+        memcpy(&value, &b, sizeof(value));
+        return value;
+    }
+    const char* str() const {
+        return (const char*)(uintptr_t)(bits_ & PAYLOAD_MASK);
+    }
+    const Vec* vec() const {
+        return (const Vec*)(uintptr_t)(bits_ & PAYLOAD_MASK);
+    }
+#else
 struct Cell {
     enum CellType {
         T_Number,
         T_String,
         T_Vector,
     };
-    const CellType type_;
+    CellType type_;
 
     union {
         TNT _num;
@@ -70,40 +138,55 @@ struct Cell {
         v._vec = vec;
     }
 
+    // unchecked access
+    CellType type() const {
+        return type_;
+    }
+    TNT num() const {
+        return v._num;
+    }
+    const char* str() const {
+        return v._str;
+    }
+    const Vec* vec() const {
+        return v._vec;
+    }
+#endif
+
     // fast access
     const char* as_string() {
-        lr_assert(type_ == T_String, "Cell type can't convert to string!");
-        return v._str;
+        lr_check(type() == T_String, "Cell type can't convert to string!");
+        return str();
     }
     bool as_boolean() {
-        lr_assert(type_ == T_Number, "Cell type can't convert to boolean!");
-        if ( v._num == 0.0) {
+        lr_check(type() == T_Number, "Cell type can't convert to boolean!");
+        if ( num() == 0.0) {
             return false;
         }
         return true;
     }
     TNT as_number() {
-        lr_assert(type_ == T_Number, "Cell type can't convert to number!");
-        return v._num;
+        lr_check(type() == T_Number, "Cell type can't convert to number!");
+        return num();
     }
     const Vec* as_vector() {
-        lr_assert(type_ == T_Vector, "Cell type can't convert to vector!");
-        return v._vec;
+        lr_check(type() == T_Vector, "Cell type can't convert to vector!");
+        return vec();
     }
     bool is_number() {
-        if ( type_ == T_Number ) {
+        if ( type() == T_Number ) {
             return true;
         }
         return false;
     }
     bool is_string() {
-        if ( type_ == T_String ) {
+        if ( type() == T_String ) {
             return true;
         }
         return false;
     }
     bool is_vector() {
-        if ( type_ == T_Vector ) {
+        if ( type() == T_Vector ) {
             return true;
         }
         return false;
@@ -113,91 +196,86 @@ struct Cell {
 std::ostream& operator<<(std::ostream& os, const Cell& c);
 
 
-// Stack & Hash
+// Stack & Hash, stack is a preallocated fixed capacity array
 struct Stack {
-    Stack() {}
+    Stack() {
+        top_ = 0;
+        data_.resize(256);
+    }
     ~Stack() {}
 
     size_t size() {
+        return top_;
+    }
+    size_t capacity() {
         return data_.size();
     }
+    void reserve(size_t n) {
+        lr_assert(top_ == 0, "Can't resize a stack in use!");
+        data_.resize(n);
+    }
     void clear() {
-        data_.clear();
+        top_ = 0;
     }
 
     Cell& top() {
-        lr_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        return data_.back();
+        lr_check(top_ > 0, "Can't access cell from empty stack!");
+        return data_[top_ - 1];
     }
     Cell pop() {
-        lr_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
-        data_.pop_back();
-        return ret;
+        lr_check(top_ > 0, "Can't access cell from empty stack!");
+        top_--;
+        return data_[top_];
     }
     void drop() {
-        lr_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        data_.pop_back();
+        lr_check(top_ > 0, "Can't access cell from empty stack!");
+        top_--;
     }
     void dup() {
-        data_.push_back( top() );
+        push( top() );
     }
     void dup2() {
         auto a = pop();
         auto b = pop();
         for(int i = 0; i < 3; i++) {
-            data_.push_back(b);
-            data_.push_back(a);
+            push(b);
+            push(a);
         }
     }
     void swap() {
-        auto a = pop();
-        auto b = pop();
-        data_.push_back(a);
-        data_.push_back(b);
+        lr_check(top_ > 1, "Can't access cell from empty stack!");
+        std::swap(data_[top_ - 1], data_[top_ - 2]);
     }
     void rot() {
         auto a = pop();
         auto b = pop();
         auto c = pop();
-        data_.push_back(b);
-        data_.push_back(a);
-        data_.push_back(c);
+        push(b);
+        push(a);
+        push(c);
     }
     TNT pop_number() {
-        lr_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
-        data_.pop_back();
-        return ret.as_number();
+        return pop().as_number();
     }
     std::vector<TNT> pop_number_list() {
         size_t s = (size_t) pop().as_number();
         std::vector<TNT> ret(s, 0.0);
         for (size_t i = 0; i < s ; i++) {
-            ret[s - i] = pop_number();
+            ret[s - 1 - i] = pop_number();
         }
         return ret;
     }
     const char* pop_string() {
-        lr_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
-        data_.pop_back();
-        return ret.as_string();
+        return pop().as_string();
     }
     const Vec* pop_vector() {
-        lr_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
-        data_.pop_back();
-        return ret.as_vector();
+        return pop().as_vector();
     }
     bool pop_boolean() {
-        lr_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
-        data_.pop_back();
-        return ret.as_boolean();
+        return pop().as_boolean();
     }
     void push_number(TNT n) {
-        data_.push_back( Cell(n) );
+        push( Cell(n) );
     }
     void push_number_list(std::vector<TNT>& list) {
         for (size_t i = 0; i < list.size(); i++) {
@@ -206,36 +284,92 @@ struct Stack {
         push_number( list.size() );
     }
     void push_vector(Vec* vec) {
-        data_.push_back( Cell(vec) );
+        push( Cell(vec) );
+    }
+
+    // unchecked access, only for words of a verified program
+    Cell raw_pop() {
+        top_--;
+        return data_[top_];
+    }
+    void raw_push(Cell cell) {
+        data_[top_] = cell;
+        top_++;
+    }
+    Cell& raw_top() {
+        return data_[top_ - 1];
+    }
+    void raw_drop(size_t n) {
+        top_ -= n;
+    }
+
+    bool refers(const Vec* vec) {
+        for (size_t i = 0; i < top_; i++) {
+            if ( data_[i].is_vector() && data_[i].vec() == vec ) {
+                return true;
+            }
+        }
+        return false;
     }
 
 private:
     void push(Cell cell) {
-        data_.push_back(cell);
+        lr_check(top_ < data_.size(), "Stack overflow, increase StackSize setting!");
+        data_[top_] = cell;
+        top_++;
     }
     void push_string(const char* str) {
-        data_.push_back( Cell(str) );
+        push( Cell(str) );
     }
 
     std::vector< Cell> data_;
+    size_t top_;
 
     friend std::ostream& operator<<(std::ostream& os, Stack& stack);
     friend struct Runtime;
 };
 std::ostream& operator<<(std::ostream& os, Stack& stack);
 
+// vector variables are shared buffers, copied only when a writer meets a live reader
+using VecRef = std::shared_ptr<Vec>;
+
+// silent and constant blocks, words with heavy per sample work check their input and skip it.
+// The scans stop at the first sample breaking the rule, a live signal costs a compare or two
+inline bool is_silent(const Vec& v, TNT threshold = 0) {
+    const TNT* d = v.data();
+    for (Eigen::Index i = 0; i < v.size(); i++) {
+        if ( std::abs(d[i]) > threshold ) {
+            return false;
+        }
+    }
+    return true;
+}
+inline bool is_constant(const Vec& v) {
+    const TNT* d = v.data();
+    for (Eigen::Index i = 1; i < v.size(); i++) {
+        if ( d[i] != d[0] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
 struct Hash {
-    using Item = std::variant<TNT, const char*, Vec>;
+    using Item = std::variant<TNT, const char*, VecRef>;
     Hash() {
         target_ = 0;
     }
     ~Hash() {}
 
     void inc() {
-        std::map<const char*, Item> new_map;
+        std::map<const char*, size_t> new_map;
         maps_.push_back( new_map );
     }
 
+    size_t target() {
+        return target_;
+    }
+
     void moveto(size_t i) {
         if ( i >= maps_.size() ) {
             lr_panic("Can't find target hash!");
@@ -243,20 +377,81 @@ struct Hash {
         target_ = i;
     }
 
+    // every (level, name) owns a fixed slot in the flat value array
+    bool has(size_t level, const char* name) {
+        return maps_[level].find(name) != maps_[level].end();
+    }
+    size_t slot(size_t level, const char* name) {
+        auto it = maps_[level].find(name);
+        if ( it != maps_[level].end() ) {
+            return it->second;
+        }
+        size_t s = values_.size();
+        values_.push_back( Item() );
+        valid_.push_back( false );
+        spares_.push_back( std::vector<VecRef>() );
+        maps_[level][name] = s;
+        return s;
+    }
+    size_t slots() {
+        return values_.size();
+    }
+    bool valid(size_t s) {
+        return valid_[s];
+    }
+    const std::map<const char*, size_t>& names(size_t level) {
+        return maps_[level];
+    }
+    Item& get(size_t s) {
+        if ( valid_[s] == false ) {
+            lr_panic("Can't find value for name!");
+        }
+        return values_[s];
+    }
+    void set(size_t s, Item item) {
+        values_[s] = std::move(item);
+        valid_[s] = true;
+    }
+
     Item find(const char* name) {
-        if ( maps_[target_].find(name) == maps_[target_].end() ) {
-            if ( target_ != 0 ) {
-                if ( maps_[0].find(name) != maps_[0].end() ) {
-                    return maps_[0][name];
-                }
+        auto it = maps_[target_].find(name);
+        if ( it != maps_[target_].end() && valid_[it->second] ) {
+            return values_[it->second];
+        }
+        if ( target_ != 0 ) {
+            it = maps_[0].find(name);
+            if ( it != maps_[0].end() && valid_[it->second] ) {
+                return values_[it->second];
             }
-            lr_panic("Can't find value for name!");
         }
-        return maps_[target_][name];
+        lr_panic("Can't find value for name!");
+        return Item();
     }
 
     void set(const char* name, Item item) {
-        maps_[target_][name] = std::move(item);
+        set( slot(target_, name), std::move(item) );
+    }
+
+    // storing a cell reuses the slot's buffer when nobody else can see it
+    void store(size_t s, Cell& cell, Stack& stack) {
+        storing(s, cell, false, [&stack](const Vec* vec) {
+            return stack.refers(vec);
+        });
+    }
+    // register code knows the registers which may still read the slot's buffer, and a buffer
+    // of the arena at its last read is swapped into the slot instead of copied
+    void store(size_t s, Cell& cell, Cell* regs, const std::vector<size_t>& readers, bool handover) {
+        storing(s, cell, handover, [regs, &readers](const Vec* vec) {
+            for (auto r : readers) {
+                if ( regs[r].is_vector() && regs[r].vec() == vec ) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+    void store(const char* name, Cell& cell, Stack& stack) {
+        store( slot(target_, name), cell, stack);
     }
 
     static Cell Item2Cell( Item* item ) {
@@ -265,25 +460,81 @@ struct Hash {
         } else if ( item->index() == 1 ) {
             return Cell( std::get<1>(*item) );
         }
-        Vec* vec = & std::get<2>(*item);
+        Vec* vec = std::get<2>(*item).get();
         return Cell(vec);
     }
 
     static Item Cell2Item( Cell& cell ) {
         Item ret;
-        if ( cell.type_ == Cell::T_Number ) {
-            ret = cell.v._num;
-        } else if ( cell.type_ == Cell::T_String ) {
-            ret = cell.v._str;
+        if ( cell.type() == Cell::T_Number ) {
+            ret = cell.num();
+        } else if ( cell.type() == Cell::T_String ) {
+            ret = cell.str();
         } else {
-            ret = *cell.v._vec;
+            ret = std::make_shared<Vec>( *cell.vec() );
         }
 
         return ret;
     }
 
 private:
-    std::vector< std::map<const char*, Item> > maps_;
+    template<typename Refers>
+    void storing(size_t s, Cell& cell, bool handover, Refers refers) {
+        auto shared = [&refers](const VecRef& vec) {
+            return vec.use_count() > 1 || refers( vec.get() );
+        };
+        if ( valid_[s] && values_[s].index() == 2 ) {
+            VecRef& cur = std::get<2>(values_[s]);
+            if ( cell.is_vector() && cell.vec() == cur.get() ) {
+                return;
+            }
+            if ( cell.is_vector() && !shared(cur) ) {
+                filling(*cur, cell, handover);
+                return;
+            }
+            // old buffer is still read from stack or another variable
+            spares_[s].push_back( cur );
+        }
+
+        if ( !cell.is_vector() ) {
+            set(s, Cell2Item(cell));
+            return;
+        }
+
+        auto& spares = spares_[s];
+        VecRef target;
+        for (size_t i = 0; i < spares.size(); ) {
+            if ( shared(spares[i]) ) {
+                i++;
+                continue;
+            }
+            if ( target == nullptr ) {
+                target = spares[i];
+            }
+            spares.erase(spares.begin() + i);
+        }
+
+        if ( target == nullptr ) {
+            target = std::make_shared<Vec>();
+        }
+        filling(*target, cell, handover);
+        set(s, target);
+    }
+    // a temporary trades its storage with the slot's buffer, nothing is copied
+    static void filling(Vec& to, Cell& cell, bool handover) {
+        if ( handover ) {
+            to.swap( *const_cast<Vec*>( cell.vec() ) );
+        } else {
+            to = *cell.vec();
+        }
+    }
+
+private:
+    std::vector< std::map<const char*, size_t> > maps_;
+    std::deque< Item > values_;
+    // flags are bytes, chains of register code set different slots at the same time
+    std::vector< char > valid_;
+    std::vector< std::vector<VecRef> > spares_;
     size_t target_;
 };
 
@@ -294,8 +545,12 @@ struct WordCode {
         Builtin,
         Native,
         User,
+        Loop,
+        LoopEnd,
     } type_;
 
+    // a counted loop is kept between Loop ( begin ) and LoopEnd ( end ) markers,
+    // both named by the hidden variable holding the loop index
     std::string str_;
     TNT num_;
 
@@ -329,6 +584,20 @@ struct WordCode {
         wc.str_ = v;
         return wc;
     }
+    static WordCode new_loop(std::string v, TNT begin) {
+        WordCode wc;
+        wc.type_ = WordCode::Loop;
+        wc.str_ = v;
+        wc.num_ = begin;
+        return wc;
+    }
+    static WordCode new_loop_end(std::string v, TNT end) {
+        WordCode wc;
+        wc.type_ = WordCode::LoopEnd;
+        wc.str_ = v;
+        wc.num_ = end;
+        return wc;
+    }
 };
 
 struct WordByte {
@@ -338,6 +607,7 @@ struct WordByte {
         BuiltinOperator,
         Native,
         User,
+        Loop,
     } type_;
 
     size_t idx_;
@@ -358,29 +628,182 @@ std::ostream& operator<<(std::ostream& os, const WordCode& c);
 // Envrioment
 struct Enviroment;
 struct Runtime;
+struct Transpiler;
+struct LivePatch;
+struct Pipeline;
 struct NativeWord {
     virtual ~NativeWord() {
     }
     virtual void run(Stack& stack) = 0;
 };
+// a native word of the register code, reading operands from registers instead of the stack,
+// args are register indexes in stack order, inputs first then outputs.
+// A vector result is written to out_, the runtime can move it into its buffer arena
+struct RegisterWord : public NativeWord {
+    RegisterWord() {
+        out_ = &result_;
+    }
+    virtual void run(Cell* regs, const size_t* args) = 0;
+    using NativeWord::run;
+
+    void assign(Vec* buffer) {
+        out_ = buffer;
+    }
+protected:
+    Vec* out_;
+private:
+    Vec result_;
+};
+struct StaticNativeWord : public NativeWord {
+    StaticNativeWord() {
+        first = false;
+    }
+    virtual void run(Stack& stack) {
+        if ( first == false ) {
+            first = true;
+            run_first(stack);
+            return;
+        }
+        run_next(stack);
+    }
+    virtual void run_first(Stack& stack) = 0;
+    virtual void run_next(Stack& stack) = 0;
+
+    // after the first run a word only popping args and pushing constant outs
+    // describes them here, the steady state program keeps just the constants
+    virtual bool steady(size_t& args, std::vector<Cell>& outs) {
+        return false;
+    }
+    bool started() {
+        return first;
+    }
+private:
+    bool first;
+};
+// a word whose top arguments only configure it ( sample rate, block size, file name ... ),
+// pushed as literals they are bound by the linker once, otherwise the word pops them
+// on every call and configures itself on the first one
+struct ConfigNativeWord : public NativeWord {
+    ConfigNativeWord(size_t configs) : configs_(configs), args_(configs) {
+        configured_ = false;
+        bound_ = false;
+    }
+    virtual void run(Stack& stack) {
+        if ( bound_ == false ) {
+            for (size_t i = configs_; i > 0; i--) {
+                args_[i - 1] = stack.pop();
+            }
+            if ( configured_ == false ) {
+                configured_ = true;
+                configure(args_);
+            }
+        }
+        run_configured(stack);
+    }
+    // args are in stack order
+    virtual void configure(std::vector<Cell>& args) = 0;
+    virtual void run_configured(Stack& stack) = 0;
+
+    void bind(std::vector<Cell> args) {
+        lr_assert(args.size() == configs_, "Binding wrong number of configuration arguments");
+        configure(args);
+        configured_ = true;
+        bound_ = true;
+    }
+    size_t configs() {
+        return configs_;
+    }
+private:
+    const size_t configs_;
+    std::vector<Cell> args_;
+    bool configured_;
+    bool bound_;
+};
+
 struct BuiltinOperator {
     virtual ~BuiltinOperator() {
     }
     virtual void run(Stack& stack, Hash& hash) = 0;
+    // an unstarted copy for a clone of the runtime
+    virtual BuiltinOperator* clone() = 0;
 };
+#define BUILTIN_CLONE_DEFINE_LR(CLS)         \
+virtual BuiltinOperator* clone() {             \
+    return new CLS(*this);                     \
+}
 using NativeCreator = NativeWord* (Enviroment&);
 using UserWord = std::vector<WordCode>;
 using UserBinary = std::vector<WordByte>;
 
+// Forth style stack effect, "n v -- v": n number, s string, v vector, other letters are type variables.
+// The optional fast creator makes an unchecked word used when the whole program is verified.
+// The optional rates have one letter per input, "c ." : c is a control input, a number read as a
+// slowly varying parameter ( see ControlRate ), . is an input at the rate of the program.
+struct WordSignature {
+    std::string in_;
+    std::string out_;
+    std::string rates_;
+    NativeCreator* fast_;
+
+    WordSignature(const char* effect, NativeCreator* fast = nullptr, const char* rates = nullptr) {
+        fast_ = fast;
+
+        std::istringstream ss(effect);
+        std::string token;
+        bool output = false;
+        while ( ss >> token ) {
+            if ( token == "--" ) {
+                output = true;
+                continue;
+            }
+            lr_assert(token.size() == 1, "Stack effect item must be one letter!");
+            if ( output ) {
+                out_.push_back( token[0] );
+            } else {
+                in_.push_back( token[0] );
+            }
+        }
+        lr_assert(output, "Stack effect must including --");
+
+        if ( rates != nullptr ) {
+            std::istringstream rs(rates);
+            while ( rs >> token ) {
+                lr_assert(token == "c" || token == ".", "Rate item must be c or .");
+                rates_.push_back( token[0] );
+            }
+            lr_assert(rates_.size() == in_.size(), "Rates must have one item per input");
+            for (size_t i = 0; i < in_.size(); i++) {
+                lr_assert(rates_[i] == '.' || in_[i] == 'n', "Only number inputs can be control inputs");
+            }
+        }
+    }
+};
+
+// the stack effect of a word bound to its configuration arguments, without them, when it
+// depends on their values ( the rows of a data file ... ), no signature leaves the word unverified
+using ConfigSignature = std::vector<WordSignature> (const std::vector<Cell>& args);
+
+// element-wise kernel over one chunk, a is the top cell and b the next one ( binary words only ),
+// a scalar argument points to a single number
+struct ElementArg {
+    const TNT* data_;
+    bool scalar_;
+};
+using ElementKernel = void (TNT* out, ElementArg a, ElementArg b, size_t n);
+
 struct Enviroment {
     using SettingValue = std::variant<bool, int, TNT>;
 
     Enviroment(int sr) {
         settings_["SampleRate"] = SettingValue(sr);
+        loops_ = 0;
         load_base_math();
     }
     ~Enviroment() {}
 
+    bool has_config(const std::string& name) {
+        return settings_.find(name) != settings_.end();
+    }
     SettingValue query_config(const std::string& name) {
         if (settings_.find(name) == settings_.end() ) {
             lr_panic("Can't find target in env's settings!");
@@ -393,6 +816,28 @@ struct Enviroment {
         }
         settings_[name] = value;
     }
+    // samples computed by one run, numbers are control values held over the whole block
+    int block_size() {
+        if ( has_config("BlockSize") ) {
+            return std::get<1>( query_config("BlockSize") );
+        }
+        return 1;
+    }
+    // approximated transcendental words, error bounds are listed in fastmath.hpp
+    bool fast_math() {
+        if ( has_config("FastMath") ) {
+            return std::get<0>( query_config("FastMath") );
+        }
+        return false;
+    }
+    // words with heavy per sample work skip silent or held input blocks, off by default:
+    // the reverb cuts its tail below -100 dB, which isn't the same output
+    bool skip_silence() {
+        if ( has_config("SkipSilence") ) {
+            return std::get<0>( query_config("SkipSilence") );
+        }
+        return false;
+    }
 
     void insert_native_word(const std::string& name, NativeCreator* fn) {
         if ( native_words_.find(name) != native_words_.end() ) {
@@ -400,106 +845,123 @@ struct Enviroment {
         }
         native_words_[name] = fn;
     }
+    void insert_native_word(const std::string& name, NativeCreator* fn, const std::vector<WordSignature>& sigs) {
+        insert_native_word(name, fn);
+        native_signatures_[name] = sigs;
+    }
+    void insert_native_word(const std::string& name, NativeCreator* fn, ConfigSignature* sigs) {
+        insert_native_word(name, fn);
+        config_signatures_[name] = sigs;
+    }
+    // element-wise words can be fused with their neighbours into one loop
+    void insert_element_kernel(const std::string& name, ElementKernel* kernel) {
+        if ( native_words_.find(name) == native_words_.end() ) {
+            lr_panic("Can't insert kernel for un registered native word!");
+        }
+        element_kernels_[name] = kernel;
+    }
+    void insert_element_kernel(const std::string& name, ElementKernel* kernel, ElementKernel* approx) {
+        insert_element_kernel(name, kernel);
+        approx_kernels_[name] = approx;
+    }
+    // pure words have no state and side effect, constant inputs are folded at link time
+    void insert_pure_word(const std::string& name, NativeCreator* fn, const std::vector<WordSignature>& sigs) {
+        insert_native_word(name, fn, sigs);
+        pure_words_.insert(name);
+    }
 
     Runtime build(const std::string& txt);
+    // compiled code is cached in a .lrc file, reused while the source, the native words and the user
+    // words defined before are the same. Only lexing and compiling are saved: linking, typing, lowering
+    // and the later passes of the Runtime run on every build
+    Runtime build(const std::string& txt, const std::string& cache);
+    NativeWord* create_native(const std::string& name) {
+        if ( native_words_.find(name) != native_words_.end() ) {
+            return native_words_[name](*this);
+        }
+        lr_panic("Call a un registered native word!");
+        return nullptr;
+    }
 
 private:
+    // settings only, native creators read nothing else
+    Enviroment(const std::map<std::string, SettingValue>& settings) : settings_(settings) {
+        loops_ = 0;
+    }
     void load_base_math();
+    uint64_t cache_key(const std::string& txt);
+    bool load_cache(const std::string& file, uint64_t key, UserWord& main_code);
+    void save_cache(const std::string& file, uint64_t key, size_t loops, const std::set<std::string>& known, const UserWord& main_code);
+    // settings visible to scripts, with defaults of the missing ones
+    std::map<std::string, SettingValue> script_settings() {
+        auto settings = settings_;
+        settings["BlockSize"] = SettingValue( block_size() );
+        return settings;
+    }
     UserWord compile(const std::string& txt) {
         struct _ {
-            static bool parse_number(const std::string& token, TNT& value) {
+            static bool parse_number(std::string_view token, TNT& value) {
                 if (isdigit(token.at(0)) || (token.at(0) == '-' && token.length() >= 2 && isdigit(token.at(1)))) {
+                    const char* end = token.data() + token.size();
                     if (token.find('.') != std::string::npos || token.find('e') != std::string::npos) { // double
-                        value = atof(token.c_str());
+                        double v = 0.0;
+                        std::from_chars(token.data(), end, v);
+                        value = v;
                     } else {
-                        value = atol(token.c_str());
+                        long v = 0;
+                        std::from_chars(token.data(), end, v);
+                        value = v;
                     }
                     return true;
                 }
                 return false;
             }
 
-            static void tokenize_line(std::string const &str_line, std::vector<std::string> &out) {
-                std::string state = "SYMBOL";
-                std::string current_str = "";
-
-                for (size_t i = 0; i < str_line.size(); i++) {
-                    char cur = str_line[i];
-                    if ( state == "SYMBOL") {
-                        if ( cur == ' ' || cur == '('  || cur == ')' || cur == '{' || cur == '}' ) {
-                            // ending of a symbol
-                            if (current_str != "") {
-                                out.push_back(current_str);
-                                current_str = "";
-                            }
-                            continue;
-                        }
-                        if ( cur == '[' || cur == ']' ) {
-                            // ending of a symbol
-                            if (current_str != "") {
-                                out.push_back(current_str);
-                                current_str = "";
-                            }
-                            out.push_back( std::string(1, cur) );
-                            continue;
-                        }
-
-                        if ( cur == '"' ) {
-                            if (current_str != "") {
-                                lr_panic("tokenize_line error!");
-                            }
-
-                            state = "STRING";
-                            current_str.push_back('"');
-                            continue;
-                        }
-                        if ( cur == '\'' ) {
-                            if (current_str != "") {
-                                lr_panic("tokenize_line error!");
-                            }
-
-                            state = "STRING";
-                            current_str.push_back('\'');
-                            continue;
-                        }
-
-                        if ( cur == ';' ) {
-                            if (current_str != "") {
-                                out.push_back(current_str);
-                            }
-                            return;
-                        }
+            // tokens are views into the source text, strings keep their quotes
+            static void tokenize_line(std::string_view line, std::vector<std::string_view>& out) {
+                size_t begin = 0;
+                size_t i = 0;
+                auto symbol = [&]() {
+                    if ( i > begin ) {
+                        out.push_back( line.substr(begin, i - begin) );
+                    }
+                    begin = i + 1;
+                };
 
-                        current_str.push_back(cur);
+                for (; i < line.size(); i++) {
+                    char cur = line[i];
+                    if ( cur == ' ' || cur == '('  || cur == ')' || cur == '{' || cur == '}' ) {
+                        symbol();
                         continue;
                     }
-                    if ( state == "STRING" ) {
-                        if ( cur == '"' && current_str.at(0) == '"') {
-                            current_str.push_back('"');
-                            out.push_back(current_str);
-                            current_str = "";
-                            state = "SYMBOL";
-                            continue;
+                    if ( cur == '[' || cur == ']' ) {
+                        symbol();
+                        out.push_back( line.substr(i, 1) );
+                        continue;
+                    }
+                    if ( cur == '"' || cur == '\'' ) {
+                        if ( i > begin ) {
+                            lr_panic("tokenize_line error!");
                         }
-                        if ( cur == '\'' && current_str.at(0) == '\'') {
-                            current_str.push_back('\'');
-                            out.push_back(current_str);
-                            current_str = "";
-                            state = "SYMBOL";
-                            continue;
+                        size_t end = line.find(cur, i + 1);
+                        if ( end == std::string_view::npos ) {
+                            lr_panic("tokenize_line error, string must end in one line!");
                         }
-                        current_str.push_back(cur);
+                        out.push_back( line.substr(i, end - i + 1) );
+                        i = end;
+                        begin = i + 1;
+                        continue;
+                    }
+                    if ( cur == ';' ) {
+                        symbol();
+                        return;
                     }
                 }
-                if ( state == "STRING" ) {
-                    lr_panic("tokenize_line error, string must end in one line!");
-                }
-                if (current_str != "") {
-                    out.push_back(current_str);
-                }
+                symbol();
             }
 
-            static UserWord loop_macro(UserWord& w) {
+            // the body is kept once, reading the loop index from a hidden variable
+            static UserWord loop_macro(UserWord& w, const std::string& var) {
                 UserWord looped;
                 if ( w.size() < 3 ) {
                     lr_panic("loop macro error, must including iden, begin, end");
@@ -512,21 +974,22 @@ private:
                 auto ident = w[0].str_;
                 auto begin = w[1].num_;
                 auto end = w[2].num_;
-                for ( TNT i = begin; i < end; i = i + 1.0) {
-                    for (size_t j = 3; j < w.size(); j++) {
-                        if ( w[j].type_ == WordCode::String ) {
-                            if ( w[j].str_ == ident ) {
-                                looped.push_back( WordCode::new_number( j ) );
-                                continue;
-                            }
+                looped.push_back( WordCode::new_loop(var, begin) );
+                for (size_t j = 3; j < w.size(); j++) {
+                    if ( w[j].type_ == WordCode::String ) {
+                        if ( w[j].str_ == ident ) {
+                            looped.push_back( WordCode::new_string(var) );
+                            looped.push_back( WordCode::new_builtin("@") );
+                            continue;
                         }
-                        looped.push_back( w[j] );
                     }
+                    looped.push_back( w[j] );
                 }
+                looped.push_back( WordCode::new_loop_end(var, end) );
                 return looped;
             }
 
-            static bool is_valid_name(std::string const &str) {
+            static bool is_valid_name(std::string_view str) {
                 if ( str == "true" || str == "false" || str == "null" || str == "@" || str == "@~" || str == "!" || str == "!~" ) {
                     return false;
                 }
@@ -540,11 +1003,12 @@ private:
         };
 
         // 0. removed comments & tokenize
-        std::vector<std::string> tokens;
-        std::istringstream code_stream(txt);
-        std::string line;
-        while (std::getline(code_stream, line)) {
-            _::tokenize_line(line,  tokens);
+        std::vector<std::string_view> tokens;
+        std::string_view code(txt);
+        while ( code.size() > 0 ) {
+            size_t end = std::min(code.find('\n'), code.size());
+            _::tokenize_line(code.substr(0, end), tokens);
+            code.remove_prefix( std::min(end + 1, code.size()) );
         }
 
         // 1. tokens post processing
@@ -577,7 +1041,7 @@ private:
                 if ( _::is_valid_name(token) ) {
                     if ( user_words_.find(token) == user_words_.end() ) {
                         if ( native_words_.find(token) == native_words_.end() ) {
-                            user_code.value().push_back( WordCode::new_string( token) );
+                            user_code.value().push_back( WordCode::new_string( std::string(token) ) );
                             continue;
                         }
                     }
@@ -598,12 +1062,19 @@ private:
                 if ( _::is_valid_name(token) ) {
                     if ( user_words_.find(token) == user_words_.end() ) {
                         if ( native_words_.find(token) == native_words_.end() ) {
-                            loop_code.value().push_back( WordCode::new_string( token) );
+                            loop_code.value().push_back( WordCode::new_string( std::string(token) ) );
                             continue;
                         }
                     }
                 }
                 lr_panic("Can't a valid ident for #loop macro!");
+            } else if ( token == "%stage" ) {
+                // a pipeline boundary, ignored when the program runs as one runtime
+                if ( user_code.has_value() || loop_code.has_value() || list_count.has_value() ) {
+                    lr_panic("Can't mark a stage boundary inside a user word, a loop or a list macro!");
+                }
+                main_code.push_back( WordCode::new_builtin("%stage") );
+                continue;
             } else if ( token == "[" ) {
                 if ( loop_code.has_value() ) {
                     lr_panic("Can't define a list macro inside a list macro!");
@@ -616,7 +1087,8 @@ private:
                 }
 
                 if ( loop_code.has_value() ) {
-                    auto looped = _::loop_macro( loop_code.value() );
+                    auto looped = _::loop_macro( loop_code.value(), "%loop" + std::to_string(loops_) );
+                    loops_++;
 
                     UserWord* target = &main_code;
                     if ( user_code.has_value() ) {
@@ -675,20 +1147,20 @@ private:
                         token == "@~" ||
                         token == "!" ||
                         token == "!~") {
-                newCode = WordCode::new_builtin( token );
+                newCode = WordCode::new_builtin( std::string(token) );
             } else if ( token[0] == '"' || token[0] == '\'' || token[0] == '$' ) {
                 if ( token[0] == '"' || token[0] == '\'' ) {
                     lr_assert( token.size() >= 2, " string must begin \" ' or $");
                     lr_assert( token[0] == token.back() , " string length wrong");
                     token = token.substr(1, token.size() - 2);
                 }
-                newCode = WordCode::new_string( token );
+                newCode = WordCode::new_string( std::string(token) );
             } else if ( _::parse_number(token, newCode.num_) ) {
                 newCode = WordCode::new_number( newCode.num_ );
             } else if ( native_words_.find( token ) != native_words_.end() ) {
-                newCode = WordCode::new_native( token );
+                newCode = WordCode::new_native( std::string(token) );
             } else if ( user_words_.find( token ) != user_words_.end() ) {
-                newCode = WordCode::new_user( token );
+                newCode = WordCode::new_user( std::string(token) );
             } else {
                 lr_panic("Find an invalid symbol is not string, number, builtin, user or native!");
             }
@@ -720,14 +1192,6 @@ private:
         return main_code;
     }
 
-    NativeWord* create_native(const std::string& name) {
-        if ( native_words_.find(name) != native_words_.end() ) {
-            return native_words_[name](*this);
-        }
-        lr_panic("Call a un registered native word!");
-        return nullptr;
-    }
-
     UserWord& get_user(const std::string& name) {
         if ( user_words_.find(name) == user_words_.end() ) {
             lr_panic("Call a un registered native word!");
@@ -736,23 +1200,36 @@ private:
     }
 
 private:
-    std::map<std::string, UserWord> user_words_;
-    std::map<std::string, NativeCreator*> native_words_;
+    // transparent maps, source tokens are looked up without copies
+    std::map<std::string, UserWord, std::less<>> user_words_;
+    std::map<std::string, NativeCreator*, std::less<>> native_words_;
+    std::map<std::string, std::vector<WordSignature>> native_signatures_;
+    std::map<std::string, ConfigSignature*> config_signatures_;
+    std::set<std::string> pure_words_;
+    std::map<std::string, ElementKernel*> element_kernels_;
+    std::map<std::string, ElementKernel*> approx_kernels_;
     std::map<std::string, SettingValue> settings_;
+    size_t loops_;
 
     friend struct Runtime;
+    friend struct LivePatch;
+    friend struct Pipeline;
 };
 
 
 struct Runtime {
 public:
     Runtime() = delete;
-    Runtime(Enviroment& env, UserWord& main_code) {
+    // a reloaded program takes over the state of the previous one, see LivePatch
+    Runtime(Enviroment& env, UserWord& main_code, Runtime* previous = nullptr) {
+        string_pool_ = std::make_shared<std::deque<std::string>>();
+        creating_ = std::shared_ptr<Enviroment>( new Enviroment(env.settings_) );
+
         // creating global ( 0 level ) hashmap
         hash_.inc();
 
         // loading all enviroment setting to runtime's hash
-        for (auto m : env.settings_) {
+        for (auto m : env.script_settings()) {
             auto value = m.second;
             size_t idx = string_id( m.first );
             const char* key = strings_[idx];
@@ -769,42 +1246,299 @@ public:
             }
         }
 
-        linking(env, main_code);
-    }
-    void run() {
-        run_(0);
-    }
+        if ( env.has_config("StackSize") ) {
+            stack_.reserve( std::get<1>( env.query_config("StackSize") ) );
+        }
+        lr_assert(env.block_size() > 0, "BlockSize must be positive");
+        block_size_ = env.block_size();
 
-    Stack& stack() {
-        return stack_;
-    }
+        // inlining is a stack code pass, lowering flattens calls into register code by itself
+        inline_ = false;
+        if ( env.has_config("RegisterCode") ) {
+            inline_ = !std::get<0>( env.query_config("RegisterCode") );
+        }
+        if ( env.has_config("InlineUserWords") ) {
+            inline_ = std::get<0>( env.query_config("InlineUserWords") );
+        }
+        inlined_ = 0;
 
-    ~Runtime() {
-        for (size_t i = 0; i < strings_.size(); i++) {
-            delete strings_[i];
+        bool fold = true;
+        if ( env.has_config("ConstantFolding") ) {
+            fold = std::get<0>( env.query_config("ConstantFolding") );
         }
-        for (size_t i = 0; i < natives_.size(); i++) {
-            delete natives_[i];
+        folding_ = fold;
+        if ( fold ) {
+            find_constants(env, main_code);
         }
-        for (size_t i = 0; i < builtins_.size(); i++) {
-            delete builtins_[i];
+
+        bind_ = true;
+        if ( env.has_config("BindConfigArgs") ) {
+            bind_ = std::get<0>( env.query_config("BindConfigArgs") );
         }
-    }
 
-private:
-    void run_(size_t from) {
-        hash_.moveto(from);
-        for ( size_t i = 0; i < binaries_[from].size(); i++) {
-            auto byte = binaries_[from][i];
+        // counted loops keep one body in stack and register code, otherwise they are unrolled at linking.
+        // Loops up to 256 codes unrolled are unrolled anyway: the index becomes a number for folding
+        loop_ = true;
+        if ( env.has_config("LoopOpcode") ) {
+            loop_ = std::get<0>( env.query_config("LoopOpcode") );
+        }
+        unroll_limit_ = 256;
+        if ( env.has_config("UnrollLimit") ) {
+            int limit = std::get<1>( env.query_config("UnrollLimit") );
+            lr_assert(limit >= 0, "UnrollLimit can't be negative");
+            unroll_limit_ = limit;
+        }
+
+        // stateful words of the previous program are found by their call site, in program order
+        if ( previous != nullptr ) {
+            for (size_t i = 0; i < previous->native_keys_.size(); i++) {
+                const std::string& key = previous->native_keys_[i];
+                if ( key.size() > 0 ) {
+                    adoptable_[key].push_back( std::make_pair(i, previous->natives_[i]) );
+                }
+            }
+        }
+
+        linking(env, main_code);
+        adoptable_.clear();
+        for (auto& m : hash_.names(0)) {
+            globals_.push_back( std::make_pair(m.first, m.second) );
+        }
+
+        // verified programs run with exact stack size and unchecked words
+        verified_ = false;
+        bool verify = true;
+        if ( env.has_config("VerifyTypes") ) {
+            verify = std::get<0>( env.query_config("VerifyTypes") );
+        }
+        if ( verify ) {
+            verified_ = typing(env);
+        }
+
+        // fused loops pay off on stack code, register code already streams arena buffers between words
+        bool fuse = false;
+        if ( env.has_config("RegisterCode") ) {
+            fuse = !std::get<0>( env.query_config("RegisterCode") );
+        }
+        if ( env.has_config("FuseVectorWords") ) {
+            fuse = std::get<0>( env.query_config("FuseVectorWords") );
+        }
+        if ( verified_ && fuse ) {
+            fusing(env);
+        }
+        if ( verified_ ) {
+            unchecking();
+        }
+
+        // control rate subgraphs of register code run once every ControlRate runs, off by default
+        decimation_ = 1;
+        phase_ = 0;
+        if ( env.has_config("ControlRate") ) {
+            int rate = std::get<1>( env.query_config("ControlRate") );
+            lr_assert(rate > 0, "ControlRate must be positive");
+            decimation_ = rate;
+        }
+
+        // independent branches of register code may run on several threads when the machine has
+        // them, chains costing less than ParallelCost sample operations are not worth a thread
+        bool branches = std::thread::hardware_concurrency() > 1;
+        bool asked = false;
+        if ( env.has_config("ParallelBranches") ) {
+            branches = std::get<0>( env.query_config("ParallelBranches") );
+            asked = branches;
+        }
+        parallel_cost_ = 16384;
+        if ( env.has_config("ParallelCost") ) {
+            int cost = std::get<1>( env.query_config("ParallelCost") );
+            lr_assert(cost >= 0, "ParallelCost can't be negative");
+            parallel_cost_ = cost;
+        }
+
+        // verified programs are lowered to register code by default. Loops keep one body there
+        // too, unless chains are asked for or control subgraphs are split, neither has branches
+        registered_ = false;
+        bool lower = true;
+        if ( env.has_config("RegisterCode") ) {
+            lower = std::get<0>( env.query_config("RegisterCode") );
+        }
+        compact_ = loop_ && !asked && decimation_ == 1;
+        proxies_ = 0;
+        if ( verified_ && lower ) {
+            registered_ = lowering(env);
+        }
+        if ( registered_ ) {
+            pruning();
+        }
+
+        // vector results of register code share a small pool of buffers
+        bool arena = true;
+        if ( env.has_config("BufferArena") ) {
+            arena = std::get<0>( env.query_config("BufferArena") );
+        }
+        parallel_ = false;
+        if ( registered_ && branches && register_loops_.empty() ) {
+            branching();
+        }
+
+        if ( registered_ && arena ) {
+            allocating();
+        }
+        if ( registered_ ) {
+            sharing();
+        }
+        if ( chains_.size() > 0 ) {
+            scheduling();
+        }
+
+        // stack code is cleaned by a peephole pass
+        bool peep = true;
+        if ( env.has_config("Peephole") ) {
+            peep = std::get<0>( env.query_config("Peephole") );
+        }
+        peephole_ = !registered_ && peep;
+        if ( peephole_ ) {
+            peephole();
+        }
+
+        if ( previous != nullptr ) {
+            carrying(*previous);
+        }
+
+        // static words are stripped after the first run
+        warmup_ = true;
+        steady_ = true;
+        if ( env.has_config("SteadyState") ) {
+            steady_ = std::get<0>( env.query_config("SteadyState") );
+        }
+
+        // direct-threaded code is the default execution mode
+        threaded_ = true;
+        if ( env.has_config("ThreadedCode") ) {
+            threaded_ = std::get<0>( env.query_config("ThreadedCode") );
+        }
+        if ( threaded_ ) {
+            threading();
+        }
+    }
+    void run() {
+        if ( warmup_ ) {
+            // the first run is the init pass
+            warmup_ = false;
+            execute_();
+            if ( steady_ ) {
+                steadying();
+            } else if ( chains_.size() > 0 ) {
+                // chains are weighed with the vectors of the first run
+                scheduling();
+            }
+            return;
+        }
+        execute_();
+    }
+
+    Stack& stack() {
+        return stack_;
+    }
+    bool verified() {
+        return verified_;
+    }
+    // samples computed by one run()
+    size_t block_size() {
+        return block_size_;
+    }
+    // patterns fired in the peephole pass
+    void dump_peephole(std::ostream& os) {
+        os << "----PEEPHOLE----" << std::endl;
+        if ( registered_ ) {
+            os << "register code, shuffles are resolved by lowering" << std::endl;
+        }
+        for (auto& m : peephole_stats_) {
+            os << m.first << "\t" << m.second << std::endl;
+        }
+        os << "----" << std::endl;
+    }
+
+    // another voice of the program, nothing is compiled, linked or verified again: code tables
+    // are copied ( steady state specializes them per voice ), interned strings are shared,
+    // natives are created again with their bound configuration. A runtime which never ran is
+    // the image, voices are cloned off the audio thread.
+    Runtime* clone() {
+        lr_assert(warmup_, "Only a runtime which never ran can be cloned!");
+        Runtime* voice = new Runtime(*this);
+        voice->cloning(*this);
+        return voice;
+    }
+
+    // a global variable, nullptr when the program never set it
+    Hash::Item* global(std::string_view name) {
+        auto it = string_ids_.find(name);
+        if ( it == string_ids_.end() || !hash_.has(0, strings_[it->second]) ) {
+            return nullptr;
+        }
+        size_t s = hash_.slot(0, strings_[it->second]);
+        return hash_.valid(s) ? &hash_.get(s) : nullptr;
+    }
+
+    ~Runtime() {
+        for (size_t i = 0; i < natives_.size(); i++) {
+            delete natives_[i];
+        }
+        for (size_t i = 0; i < builtins_.size(); i++) {
+            delete builtins_[i];
+        }
+    }
+
+private:
+    // a counted loop: its body binary runs count times, the index is kept in a hash slot
+    struct LoopCode {
+        size_t body;
+        size_t slot;
+        TNT begin;
+        size_t count;
+        size_t iteration;
+        bool closed;
+    };
+    // a global variable handed over by the previous program, its static initializers are skipped
+    struct Carry {
+        size_t from;
+        size_t to;
+        std::vector<bool*> inits;
+        bool string;
+    };
+
+    void execute_() {
+        if ( registered_ ) {
+            run_register_();
+            return;
+        }
+        if ( threaded_ ) {
+            run_threaded_(0);
+            return;
+        }
+        run_(0);
+    }
+
+    void run_(size_t from) {
+        hash_.moveto(from);
+        for ( size_t i = 0; i < binaries_[from].size(); i++) {
+            auto byte = binaries_[from][i];
             switch( byte.type_ ) {
                 case WordByte::Number:
-                    stack_.push_number( byte.num_ );
+                    if ( verified_ ) {
+                        stack_.raw_push( Cell(byte.num_) );
+                    } else {
+                        stack_.push_number( byte.num_ );
+                    }
                     break;
 
                 case WordByte::String:
                     {
                         const char* str = strings_[ byte.idx_ ];
-                        stack_.push_string(str);
+                        if ( verified_ ) {
+                            stack_.raw_push( Cell(str) );
+                        } else {
+                            stack_.push_string(str);
+                        }
                     }
                     break;
 
@@ -817,140 +1551,3092 @@ private:
                     break;
 
                 case WordByte::User:
-                    run_(from + 1);
+                    run_( byte.idx_ );
+                    hash_.moveto(from);
+                    break;
+
+                case WordByte::Loop:
+                    run_loop_( loops_[byte.idx_] );
+                    hash_.moveto(from);
                     break;
             }
         }
     }
 
-    void linking(Enviroment& env, UserWord& word) {
-        size_t bin_id = binaries_.size();
-        binaries_.push_back( UserBinary() );
+    // the loop index lives in a hash slot, the body reads it like a variable
+    void run_loop_(LoopCode& loop) {
+        Hash::Item& index = hash_.get(loop.slot);
+        for (size_t k = 0; k < loop.count; k++) {
+            loop.iteration = k;
+            index = loop.begin + (TNT)k;
+            if ( threaded_ ) {
+                run_threaded_(loop.body);
+            } else {
+                run_(loop.body);
+            }
+        }
+    }
 
-        UserBinary bin;
+    // direct-threaded code: every WordByte is pre-resolved to a handler and its operand
+    struct ThreadedOp;
+    using ThreadedHandler = void (*)(Runtime& rt, const ThreadedOp& op);
+    struct ThreadedOp {
+        ThreadedHandler fn_;
+        union {
+            TNT num_;
+            const char* str_;
+            BuiltinOperator* builtin_;
+            NativeWord* native_;
+            size_t bin_;
+        } v;
+    };
+    using ThreadedBinary = std::vector<ThreadedOp>;
 
-        for(size_t i = 0; i < word.size(); i++) {
-            auto code = word[i];
-            switch( code.type_ ) {
-                case WordCode::Number :
-                    bin.push_back( WordByte( code.num_ ) );
+    static void op_number(Runtime& rt, const ThreadedOp& op) {
+        rt.stack_.push_number( op.v.num_ );
+    }
+    static void op_string(Runtime& rt, const ThreadedOp& op) {
+        rt.stack_.push_string( op.v.str_ );
+    }
+    static void op_number_raw(Runtime& rt, const ThreadedOp& op) {
+        rt.stack_.raw_push( Cell(op.v.num_) );
+    }
+    static void op_string_raw(Runtime& rt, const ThreadedOp& op) {
+        rt.stack_.raw_push( Cell(op.v.str_) );
+    }
+    static void op_builtin(Runtime& rt, const ThreadedOp& op) {
+        op.v.builtin_->run( rt.stack_, rt.hash_ );
+    }
+    static void op_native(Runtime& rt, const ThreadedOp& op) {
+        op.v.native_->run( rt.stack_ );
+    }
+    static void op_user(Runtime& rt, const ThreadedOp& op) {
+        size_t from = rt.hash_.target();
+        rt.run_threaded_( op.v.bin_ );
+        rt.hash_.moveto(from);
+    }
+    static void op_loop(Runtime& rt, const ThreadedOp& op) {
+        size_t from = rt.hash_.target();
+        rt.run_loop_( rt.loops_[op.v.bin_] );
+        rt.hash_.moveto(from);
+    }
+
+    void run_threaded_(size_t from) {
+        hash_.moveto(from);
+        const ThreadedOp* op = threaded_binaries_[from].data();
+        const ThreadedOp* end = op + threaded_binaries_[from].size();
+        for ( ; op != end; op++) {
+            op->fn_(*this, *op);
+        }
+    }
+
+    void threading() {
+        threaded_binaries_.resize( binaries_.size() );
+        for (size_t b = 0; b < binaries_.size(); b++) {
+            ThreadedBinary& tbin = threaded_binaries_[b];
+            tbin.resize( binaries_[b].size() );
+
+            for (size_t i = 0; i < binaries_[b].size(); i++) {
+                auto& byte = binaries_[b][i];
+                auto& op = tbin[i];
+                switch( byte.type_ ) {
+                    case WordByte::Number:
+                        op.fn_ = verified_ ? op_number_raw : op_number;
+                        op.v.num_ = byte.num_;
+                        break;
+
+                    case WordByte::String:
+                        op.fn_ = verified_ ? op_string_raw : op_string;
+                        op.v.str_ = strings_[ byte.idx_ ];
+                        break;
+
+                    case WordByte::BuiltinOperator:
+                        op.fn_ = op_builtin;
+                        op.v.builtin_ = builtins_[ byte.idx_ ];
+                        break;
+
+                    case WordByte::Native:
+                        op.fn_ = op_native;
+                        op.v.native_ = natives_[ byte.idx_ ];
+                        break;
+
+                    case WordByte::User:
+                        op.fn_ = op_user;
+                        op.v.bin_ = byte.idx_;
+                        break;
+
+                    case WordByte::Loop:
+                        op.fn_ = op_loop;
+                        op.v.bin_ = byte.idx_;
+                        break;
+                }
+            }
+        }
+    }
+
+    // register code: every cell produced by a verified program gets its own register,
+    // constants are loaded once and stack shuffling words are only renaming at lowering
+    struct RegisterOp {
+        enum {
+            Word,
+            Native,
+            Builtin,
+            Fused,
+            Load,
+            Store,
+            StaticStore,
+            Ramp,
+            LoopBegin,
+            LoopEnd,
+        } kind_;
+        union {
+            RegisterWord* word_;
+            NativeWord* native_;
+            BuiltinOperator* builtin_;
+            size_t slot_;
+        } v;
+        size_t in_;
+        std::vector<size_t> args_;
+        bool first_;
+        bool pure_;
+        bool vector_;
+        Vec* buffer_;
+        size_t chain_;
+        // numbers in and out, rates of the inputs from the signature
+        bool numeric_;
+        std::string rates_;
+        bool control_;
+        // stores: registers which may read the slot's buffer later, and an arena buffer taken over
+        std::vector<size_t> readers_;
+        bool handover_;
+    };
+    // a control result goes to its readers in decimation_ equal steps
+    struct Ramp {
+        TNT to;
+        TNT step;
+        bool started;
+    };
+    // a compact loop of register code, its body runs between two markers and its index is a register
+    struct RegisterLoop {
+        TNT begin;
+        size_t count;
+        size_t enter;       // the LoopBegin marker
+        size_t next;        // the LoopEnd marker
+        size_t left;
+    };
+
+    void run_register_() {
+        hash_.moveto(0);
+        Cell* regs = registers_.data_.data();
+        // threads busy with another runtime leave the block to this one alone
+        if ( parallel_ && Workers::shared().acquire() ) {
+            Workers::shared().run(this, regs);
+            Workers::shared().release();
+        } else {
+            for (size_t i = 0; i < register_code_.size(); i++) {
+                RegisterOp& op = register_code_[i];
+                if ( phase_ > 0 && op.control_ ) {
+                    continue;
+                }
+                if ( op.kind_ >= RegisterOp::LoopBegin ) {
+                    i = jumping_(op, regs, i);
+                    continue;
+                }
+                run_register_op_(op, regs, stack_);
+            }
+        }
+        ticking();
+    }
+
+    // loop-back branch of a compact loop, returns the operation before the next one to run
+    size_t jumping_(RegisterOp& op, Cell* regs, size_t i) {
+        RegisterLoop& loop = register_loops_[op.v.slot_];
+        if ( op.kind_ == RegisterOp::LoopBegin ) {
+            loop.left = loop.count;
+            regs[ op.args_[0] ] = Cell(loop.begin);
+            return loop.count == 0 ? loop.next : i;
+        }
+        if ( --loop.left == 0 ) {
+            return i;
+        }
+        regs[ op.args_[0] ] = Cell( loop.begin + (TNT)(loop.count - loop.left) );
+        return loop.enter;
+    }
+
+    // control operations run at phase 0 only
+    void ticking() {
+        if ( ++phase_ == decimation_ ) {
+            phase_ = 0;
+        }
+    }
+
+    // a chain owns a stack, operations of independent chains run at the same time
+    void run_chain_(size_t c, Cell* regs) {
+        Chain& chain = chains_[c];
+        for (auto i : chain.ops) {
+            RegisterOp& op = register_code_[i];
+            if ( phase_ > 0 && op.control_ ) {
+                continue;
+            }
+            run_register_op_(op, regs, chain_stacks_[c]);
+        }
+    }
+
+    // threads running the chains of register code, started once for the process. After a block
+    // they spin a while then park until the next one, so back to back blocks don't wake them up.
+    // The audio thread takes chains too and never waits on a lock: a block ends once every chain
+    // is taken and the threads which took one are done
+    struct Workers {
+        static Workers& shared() {
+            static Workers workers( std::thread::hardware_concurrency() );
+            return workers;
+        }
+        Workers(size_t cores) {
+            generation_ = 0;
+            active_ = 0;
+            sleepers_ = 0;
+            closed_ = true;
+            busy_ = false;
+            stop_ = false;
+            capacity_ = 0;
+            for (size_t k = 1; k < cores; k++) {
+                threads_.emplace_back( [this]() {
+                    working();
+                });
+            }
+        }
+        ~Workers() {
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                stop_ = true;
+            }
+            parked_.notify_all();
+            for (auto& thread : threads_) {
+                thread.join();
+            }
+        }
+
+        // threads of a block, the caller included
+        size_t threads() {
+            return threads_.size() + 1;
+        }
+        // one runtime at a time
+        bool acquire() {
+            bool free = false;
+            return busy_.compare_exchange_strong(free, true, std::memory_order_acquire);
+        }
+        void release() {
+            busy_.store(false, std::memory_order_release);
+        }
+        // counters are allocated when a runtime is built, not on the audio thread
+        void reserve(size_t chains) {
+            while ( !acquire() ) {
+                std::this_thread::yield();
+            }
+            if ( chains > capacity_ ) {
+                pending_.reset( new std::atomic<size_t>[chains] );
+                ready_.reset( new std::atomic<size_t>[chains] );
+                capacity_ = chains;
+            }
+            release();
+        }
+
+        // chains without inputs are ready first, a chain is ready when its last input is done
+        void run(Runtime* rt, Cell* regs) {
+            rt_ = rt;
+            regs_ = regs;
+            total_ = rt->chains_.size();
+            pushed_.store(0, std::memory_order_relaxed);
+            taken_.store(0, std::memory_order_relaxed);
+            for (size_t c = 0; c < total_; c++) {
+                pending_[c].store(rt->chains_[c].deps, std::memory_order_relaxed);
+                ready_[c].store(0, std::memory_order_relaxed);
+            }
+            for (size_t c = 0; c < total_; c++) {
+                if ( rt->chains_[c].deps == 0 ) {
+                    readying(c);
+                }
+            }
+
+            closed_.store(false);
+            generation_.fetch_add(1);
+            if ( sleepers_.load() > 0 ) {
+                std::lock_guard<std::mutex> guard(lock_);
+                parked_.notify_all();
+            }
+            taking();
+            // a thread coming later sees the block closed and doesn't join it
+            closed_.store(true);
+            while ( active_.load() > 0 ) {
+            }
+        }
+
+    private:
+        static const size_t spins = 1 << 16;
+
+        void working() {
+            size_t seen = 0;
+            while ( true ) {
+                size_t generation = generation_.load();
+                for (size_t i = 0; generation == seen && i < spins; i++) {
+                    generation = generation_.load();
+                }
+                if ( generation == seen ) {
+                    std::unique_lock<std::mutex> guard(lock_);
+                    sleepers_++;
+                    parked_.wait(guard, [this, seen]() {
+                        return stop_ || generation_.load() != seen;
+                    });
+                    sleepers_--;
+                    if ( stop_ ) {
+                        return;
+                    }
+                    generation = generation_.load();
+                }
+                seen = generation;
+
+                active_++;
+                if ( !closed_.load() ) {
+                    taking();
+                }
+                active_--;
+            }
+        }
+
+        // ready chains are taken in order, until every chain of the block is taken
+        void taking() {
+            while ( true ) {
+                size_t at = taken_.load(std::memory_order_acquire);
+                if ( at == total_ ) {
+                    return;
+                }
+                size_t c = ready_[at].load(std::memory_order_acquire);
+                if ( c == 0 ) {
+                    continue;
+                }
+                if ( !taken_.compare_exchange_weak(at, at + 1, std::memory_order_acq_rel) ) {
+                    continue;
+                }
+                rt_->run_chain_(c - 1, regs_);
+                for (auto n : rt_->chains_[c - 1].next) {
+                    if ( pending_[n].fetch_sub(1, std::memory_order_acq_rel) == 1 ) {
+                        readying(n);
+                    }
+                }
+            }
+        }
+        void readying(size_t c) {
+            size_t at = pushed_.fetch_add(1, std::memory_order_relaxed);
+            ready_[at].store(c + 1, std::memory_order_release);
+        }
+
+        std::vector<std::thread> threads_;
+        std::mutex lock_;
+        std::condition_variable parked_;
+        bool stop_;
+        std::atomic<size_t> generation_;
+        std::atomic<size_t> active_;
+        std::atomic<size_t> sleepers_;
+        std::atomic<bool> closed_;
+        std::atomic<bool> busy_;
+
+        Runtime* rt_;
+        Cell* regs_;
+        size_t total_;
+        size_t capacity_;
+        std::unique_ptr<std::atomic<size_t>[]> pending_;
+        std::unique_ptr<std::atomic<size_t>[]> ready_;
+        std::atomic<size_t> pushed_;
+        std::atomic<size_t> taken_;
+    };
+
+    inline void run_register_op_(RegisterOp& op, Cell* regs, Stack& stack) {
+        const size_t* args = op.args_.data();
+        switch( op.kind_ ) {
+            case RegisterOp::Word:
+                // words can be shared by several operations, each one has its own buffer
+                if ( op.buffer_ != nullptr ) {
+                    op.v.word_->assign(op.buffer_);
+                }
+                op.v.word_->run(regs, args);
+                break;
+
+            case RegisterOp::Load:
+                regs[ args[0] ] = Hash::Item2Cell( &hash_.get(op.v.slot_) );
+                break;
+
+            case RegisterOp::Store:
+                // live references are known from the code, the register file isn't scanned
+                hash_.store(op.v.slot_, regs[ args[0] ], regs, op.readers_, op.handover_);
+                break;
+
+            case RegisterOp::StaticStore:
+                if ( op.first_ == false ) {
+                    op.first_ = true;
+                    hash_.store(op.v.slot_, regs[ args[0] ], regs, op.readers_, op.handover_);
+                }
+                break;
+
+            case RegisterOp::Ramp:
+                {
+                    // a new value at phase 0 is reached at the last phase, the first one is taken as is
+                    Ramp& ramp = ramps_[op.v.slot_];
+                    if ( phase_ == 0 ) {
+                        TNT to = regs[ args[0] ].as_number();
+                        ramp.step = ramp.started ? (to - ramp.to) / (TNT)decimation_ : 0;
+                        ramp.to = to;
+                        ramp.started = true;
+                    }
+                    regs[ args[1] ] = Cell( ramp.to - ramp.step * (TNT)(decimation_ - 1 - phase_) );
+                }
+                break;
+
+            case RegisterOp::Fused:
+                static_cast<BuiltinFused*>(op.v.builtin_)->run(regs, args, hash_, op.buffer_);
+                break;
+
+            // branches are taken by run_register_, see jumping_
+            case RegisterOp::LoopBegin:
+            case RegisterOp::LoopEnd:
+                break;
+
+            // words without a register version run on the stack
+            case RegisterOp::Native:
+            case RegisterOp::Builtin:
+                for (size_t j = 0; j < op.in_; j++) {
+                    stack.raw_push( regs[ args[j] ] );
+                }
+                if ( op.kind_ == RegisterOp::Native ) {
+                    op.v.native_->run( stack );
+                } else {
+                    op.v.builtin_->run( stack, hash_ );
+                }
+                for (size_t j = op.args_.size(); j > op.in_; j--) {
+                    regs[ args[j - 1] ] = stack.raw_pop();
+                }
+                stack.clear();
+                break;
+        }
+    }
+
+    bool lowering(Enviroment& env) {
+        std::vector<size_t> stack;
+        std::vector<Cell> values;
+        bool lowered = lowering_(env, 0, stack, values, 0);
+        computed_.clear();
+        if ( lowered == false ) {
+            register_code_.clear();
+            register_loops_.clear();
+            return false;
+        }
+        if ( decimation_ > 1 ) {
+            decimating(values);
+        }
+
+        registers_.reserve( std::max(values.size(), (size_t)1) );
+        for (size_t i = 0; i < values.size(); i++) {
+            registers_.data_[i] = values[i];
+        }
+        registers_.top_ = values.size();
+        return true;
+    }
+
+    // rate inference: a control operation is a pure one with numbers in and out ( or a variable
+    // load ) whose results are only read by control inputs and other control operations, reads
+    // flow back from the readers in one pass. Results read by control inputs get a Ramp, the
+    // readers take the ramped register while the control subgraph skips decimation_ - 1 runs
+    void decimating(std::vector<Cell>& values) {
+        std::vector<size_t> reads( values.size(), 0 );
+        std::vector<size_t> slow( values.size(), 0 );
+        std::vector<size_t> fed( values.size(), 0 );
+        for (size_t i = register_code_.size(); i > 0; i--) {
+            RegisterOp& op = register_code_[i - 1];
+            bool control = op.args_.size() > op.in_;
+            control = control && ( op.kind_ == RegisterOp::Load || ( op.pure_ && op.numeric_ ) );
+            for (size_t j = op.in_; control && j < op.args_.size(); j++) {
+                size_t r = op.args_[j];
+                control = reads[r] > 0 && slow[r] == reads[r];
+            }
+            op.control_ = control;
+
+            for (size_t j = 0; j < op.in_; j++) {
+                size_t r = op.args_[j];
+                reads[r]++;
+                if ( control ) {
+                    slow[r]++;
+                } else if ( j < op.rates_.size() && op.rates_[j] == 'c' ) {
+                    slow[r]++;
+                    fed[r]++;
+                }
+            }
+        }
+
+        const size_t none = (size_t)-1;
+        std::vector<size_t> ramped( values.size(), none );
+        std::vector<RegisterOp> code;
+        for (auto& op : register_code_) {
+            if ( !op.control_ ) {
+                for (size_t j = 0; j < op.in_; j++) {
+                    if ( ramped[ op.args_[j] ] != none ) {
+                        op.args_[j] = ramped[ op.args_[j] ];
+                    }
+                }
+            }
+            code.push_back(op);
+            if ( !op.control_ ) {
+                continue;
+            }
+            for (size_t j = op.in_; j < op.args_.size(); j++) {
+                size_t r = op.args_[j];
+                if ( fed[r] == 0 ) {
+                    continue;
+                }
+                RegisterOp ramp;
+                ramp.kind_ = RegisterOp::Ramp;
+                ramp.v.slot_ = ramps_.size();
+                ramp.in_ = 1;
+                ramp.args_ = { r, values.size() };
+                ramp.first_ = false;
+                ramp.pure_ = true;
+                ramp.vector_ = false;
+                ramp.buffer_ = nullptr;
+                ramp.chain_ = 0;
+                ramp.numeric_ = true;
+                ramp.control_ = false;
+                ramp.handover_ = false;
+                ramps_.push_back( Ramp{0, 0, false} );
+
+                ramped[r] = values.size();
+                values.push_back( Cell((TNT)0) );
+                code.push_back(ramp);
+            }
+        }
+        register_code_ = code;
+    }
+
+    bool lowering_(Enviroment& env, size_t bin, std::vector<size_t>& stack, std::vector<Cell>& values, size_t level) {
+        if ( level > 64 ) {
+            return false;
+        }
+        auto output = [this, &values](RegisterOp& op) {
+            op.args_.push_back( values.size() );
+            computed_.insert( values.size() );
+            values.push_back( Cell() );
+            return op.args_.back();
+        };
+
+        for (size_t i = 0; i < binaries_[bin].size(); i++) {
+            auto& byte = binaries_[bin][i];
+            RegisterOp op;
+            op.in_ = 0;
+            op.first_ = false;
+            op.pure_ = false;
+            op.vector_ = false;
+            op.buffer_ = nullptr;
+            op.chain_ = 0;
+            op.numeric_ = false;
+            op.control_ = false;
+            op.handover_ = false;
+
+            switch( byte.type_ ) {
+                case WordByte::Number:
+                    stack.push_back( values.size() );
+                    values.push_back( Cell(byte.num_) );
+                    break;
+
+                case WordByte::String:
+                    stack.push_back( values.size() );
+                    values.push_back( Cell(strings_[byte.idx_]) );
                     break;
 
-                case WordCode::String :
-                    bin.push_back( WordByte( WordByte::String, string_id( code.str_ ) ) );
-                    break;
+                case WordByte::User:
+                    if ( lowering_(env, byte.idx_, stack, values, level + 1) == false ) {
+                        return false;
+                    }
+                    break;
+
+                case WordByte::Loop:
+                    {
+                        LoopCode& loop = loops_[byte.idx_];
+                        if ( compact_ && compacting(env, loop, stack, values, level) ) {
+                            break;
+                        }
+                        // otherwise every iteration is lowered with its index as a constant
+                        for (size_t k = 0; k < loop.count; k++) {
+                            loop.iteration = k;
+                            loop_registers_[loop.slot] = values.size();
+                            values.push_back( Cell( loop.begin + (TNT)k ) );
+                            if ( lowering_(env, loop.body, stack, values, level + 1) == false ) {
+                                return false;
+                            }
+                        }
+                        loop_registers_.erase(loop.slot);
+                        loop.iteration = 0;
+                    }
+                    break;
+
+                case WordByte::BuiltinOperator:
+                    {
+                        BuiltinOperator* builtin = loop_instance( builtins_[byte.idx_] );
+                        if ( builtin != builtins_[byte.idx_] ) {
+                            proxies_++;
+                        }
+                        if ( auto get = dynamic_cast<BuiltinSlotGet*>(builtin) ) {
+                            auto index = loop_registers_.find(get->slot);
+                            if ( index != loop_registers_.end() ) {
+                                stack.push_back( index->second );
+                                break;
+                            }
+                            op.kind_ = RegisterOp::Load;
+                            op.v.slot_ = get->slot;
+                            op.pure_ = true;
+                            stack.push_back( output(op) );
+                        } else if ( auto set = dynamic_cast<BuiltinSlotSet*>(builtin) ) {
+                            op.kind_ = RegisterOp::Store;
+                            op.v.slot_ = set->slot;
+                            op.in_ = 1;
+                            op.args_.push_back( stack.back() );
+                            stack.pop_back();
+                        } else if ( auto sset = dynamic_cast<BuiltinSlotStaticSet*>(builtin) ) {
+                            op.kind_ = RegisterOp::StaticStore;
+                            op.v.slot_ = sset->slot;
+                            op.in_ = 1;
+                            op.args_.push_back( stack.back() );
+                            stack.pop_back();
+                        } else {
+                            size_t in = 0;
+                            size_t out = 1;
+                            op.kind_ = RegisterOp::Builtin;
+                            if ( auto fused = dynamic_cast<BuiltinFused*>(builtin) ) {
+                                // fused loops write an arena buffer straight from the registers
+                                op.kind_ = RegisterOp::Fused;
+                                op.vector_ = true;
+                                in = fused->inputs;
+                            } else if ( auto input = dynamic_cast<BuiltinStageInput*>(builtin) ) {
+                                out = input->types.size();
+                            } else if ( dynamic_cast<BuiltinStageOutput*>(builtin) ) {
+                                in = stack.size();
+                                out = 0;
+                            } else if ( dynamic_cast<BuiltinSlotStaticGet*>(builtin) == nullptr ) {
+                                return false;
+                            }
+                            op.v.builtin_ = builtin;
+                            op.in_ = in;
+                            op.args_.assign( stack.end() - in, stack.end() );
+                            stack.resize( stack.size() - in );
+                            for (size_t j = 0; j < out; j++) {
+                                stack.push_back( output(op) );
+                            }
+                        }
+                        register_code_.push_back(op);
+                    }
+                    break;
+
+                case WordByte::Native:
+                    {
+                        auto pick = picks_[byte.idx_];
+                        if ( pick == nullptr ) {
+                            return false;
+                        }
+                        size_t in = pick->in_.size();
+                        lr_assert(stack.size() >= in, "Lowering a program with wrong stack effect");
+
+                        if ( is_shuffle(env, byte.idx_) ) {
+                            std::vector<size_t> ins(stack.end() - in, stack.end());
+                            stack.resize( stack.size() - in );
+                            for (size_t j = 0; j < pick->out_.size(); j++) {
+                                stack.push_back( ins[ pick->in_.find( pick->out_[j] ) ] );
+                            }
+                            break;
+                        }
+
+                        // pure number words over literal registers are evaluated here, shuffles and
+                        // inlined calls don't keep literals apart like they do for folding on code
+                        bool pure = env.pure_words_.find( native_names_[byte.idx_] ) != env.pure_words_.end();
+                        bool numeric = ( pick->in_ + pick->out_ ).find_first_not_of('n') == std::string::npos;
+                        bool literal = folding_ && pure && numeric;
+                        for (size_t j = stack.size() - in; literal && j < stack.size(); j++) {
+                            literal = computed_.find( stack[j] ) == computed_.end() && values[ stack[j] ].is_number();
+                        }
+                        if ( literal ) {
+                            Stack scratch;
+                            for (size_t j = stack.size() - in; j < stack.size(); j++) {
+                                scratch.push_number( values[ stack[j] ].as_number() );
+                            }
+                            NativeWord* word = env.create_native( native_names_[byte.idx_] );
+                            word->run(scratch);
+                            delete word;
+
+                            std::vector<TNT> results( pick->out_.size() );
+                            for (size_t j = results.size(); j > 0; j--) {
+                                results[j - 1] = scratch.pop_number();
+                            }
+                            stack.resize( stack.size() - in );
+                            for (auto r : results) {
+                                stack.push_back( values.size() );
+                                values.push_back( Cell(r) );
+                            }
+                            break;
+                        }
+
+                        NativeWord* native = loop_instance( natives_[byte.idx_] );
+                        if ( native != natives_[byte.idx_] ) {
+                            proxies_++;
+                        }
+                        if ( auto word = dynamic_cast<RegisterWord*>(native) ) {
+                            op.kind_ = RegisterOp::Word;
+                            op.v.word_ = word;
+                            op.vector_ = pick->out_ == "v";
+                        } else {
+                            op.kind_ = RegisterOp::Native;
+                            op.v.native_ = native;
+                        }
+                        op.pure_ = pure;
+                        op.numeric_ = numeric;
+                        op.rates_ = pick->rates_;
+                        op.in_ = in;
+                        op.args_.assign( stack.end() - in, stack.end() );
+                        stack.resize( stack.size() - in );
+                        if ( native_names_[byte.idx_] == "?" ) {
+                            // dumping reads the whole stack
+                            op.in_ = stack.size();
+                            op.args_ = stack;
+                        }
+                        for (size_t j = 0; j < pick->out_.size(); j++) {
+                            stack.push_back( output(op) );
+                        }
+                        register_code_.push_back(op);
+                    }
+                    break;
+            }
+        }
+        return true;
+    }
+
+    // a loop keeps one lowered body between two markers when the body leaves the stack as it was
+    // and needs no word instance per iteration, otherwise everything lowered here is rolled back
+    bool compacting(Enviroment& env, LoopCode& loop, std::vector<size_t>& stack, std::vector<Cell>& values, size_t level) {
+        const size_t code = register_code_.size();
+        const size_t regs = values.size();
+        const size_t loops = register_loops_.size();
+        const size_t proxies = proxies_;
+        const std::vector<size_t> entry = stack;
+
+        RegisterOp marker;
+        marker.kind_ = RegisterOp::LoopBegin;
+        marker.v.slot_ = loops;
+        marker.in_ = 0;
+        marker.args_ = { regs };
+        marker.first_ = false;
+        marker.pure_ = false;
+        marker.vector_ = false;
+        marker.buffer_ = nullptr;
+        marker.chain_ = 0;
+        marker.numeric_ = false;
+        marker.control_ = false;
+        marker.handover_ = false;
+        register_loops_.push_back( RegisterLoop{loop.begin, loop.count, 0, 0, 0} );
+        register_code_.push_back(marker);
+
+        computed_.insert( regs );
+        values.push_back( Cell(loop.begin) );
+        loop_registers_[loop.slot] = regs;
+        bool lowered = lowering_(env, loop.body, stack, values, level + 1);
+        loop_registers_.erase(loop.slot);
+
+        if ( lowered && proxies_ == proxies && stack == entry ) {
+            marker.kind_ = RegisterOp::LoopEnd;
+            register_code_.push_back(marker);
+            return true;
+        }
+        register_code_.resize(code);
+        register_loops_.resize(loops);
+        values.resize(regs);
+        computed_.erase( computed_.lower_bound(regs), computed_.end() );
+        stack = entry;
+        proxies_ = proxies;
+        return false;
+    }
+
+    // markers of compact loops find each other again after a pass removed operations
+    void looping() {
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            if ( op.kind_ == RegisterOp::LoopBegin ) {
+                register_loops_[op.v.slot_].enter = i;
+            } else if ( op.kind_ == RegisterOp::LoopEnd ) {
+                register_loops_[op.v.slot_].next = i;
+            }
+        }
+    }
+
+    // the last operation reading a register, a register written before a compact loop and
+    // read in its body is read again by the next iteration, until the end of the loop
+    std::vector<size_t> last_reads() {
+        const size_t none = (size_t)-1;
+        std::vector<size_t> def( registers_.size(), none );
+        std::vector<size_t> last( registers_.size(), 0 );
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            for (size_t j = 0; j < op.in_; j++) {
+                last[ op.args_[j] ] = i;
+            }
+            for (size_t j = op.in_; j < op.args_.size(); j++) {
+                if ( def[ op.args_[j] ] == none ) {
+                    def[ op.args_[j] ] = i;
+                }
+            }
+        }
+        for (auto& loop : register_loops_) {
+            for (size_t i = loop.enter; i < loop.next; i++) {
+                RegisterOp& op = register_code_[i];
+                for (size_t j = 0; j < op.in_; j++) {
+                    size_t r = op.args_[j];
+                    if ( def[r] == none || def[r] < loop.enter ) {
+                        last[r] = std::max( last[r], loop.next );
+                    }
+                }
+            }
+        }
+        return last;
+    }
+
+    // buffer arena: live ranges of vector registers are known from the register code,
+    // a buffer goes back to the pool after the last read of its value
+    void allocating() {
+        auto last = last_reads();
+
+        // every chain has its own pool, values read by other chains keep their buffers
+        std::vector<bool> crossing( registers_.size(), false );
+        std::vector<size_t> chain( registers_.size(), 0 );
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            for (size_t j = op.in_; j < op.args_.size(); j++) {
+                chain[ op.args_[j] ] = op.chain_;
+            }
+            for (size_t j = 0; j < op.in_; j++) {
+                if ( chain[ op.args_[j] ] != op.chain_ ) {
+                    crossing[ op.args_[j] ] = true;
+                }
+            }
+        }
+
+        std::map<size_t, std::vector<Vec*>> pools;
+        std::map<size_t, Vec*> live;
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            auto& pool = pools[op.chain_];
+            if ( op.vector_ ) {
+                if ( pool.size() == 0 ) {
+                    arena_.push_back( Vec() );
+                    pool.push_back( &arena_.back() );
+                }
+                op.buffer_ = pool.back();
+                pool.pop_back();
+                live[ op.args_[op.in_] ] = op.buffer_;
+            }
+
+            // outputs are assigned before inputs are released, a word never writes to its operand
+            for (size_t j = 0; j < op.args_.size(); j++) {
+                size_t r = op.args_[j];
+                auto it = live.find(r);
+                if ( it != live.end() && last[r] <= i && !crossing[r] ) {
+                    pool.push_back( it->second );
+                    live.erase(it);
+                }
+            }
+        }
+    }
+
+    // registers which may point to the buffer of a hash slot: loads of the slot, and outputs of
+    // words run on the stack with such an input ( a native may hand its input back )
+    std::vector<std::set<size_t>> aliasing() {
+        std::vector<std::set<size_t>> slots( registers_.size() );
+        for (auto& op : register_code_) {
+            if ( op.kind_ == RegisterOp::Load ) {
+                slots[ op.args_[0] ].insert( op.v.slot_ );
+            } else if ( op.kind_ == RegisterOp::Native ) {
+                std::set<size_t> in;
+                for (size_t j = 0; j < op.in_; j++) {
+                    in.insert( slots[ op.args_[j] ].begin(), slots[ op.args_[j] ].end() );
+                }
+                for (size_t j = op.in_; j < op.args_.size(); j++) {
+                    slots[ op.args_[j] ] = in;
+                }
+            }
+        }
+        return slots;
+    }
+
+    // a store checks the registers written before it and read after it which may point to the
+    // slot's buffer, and takes over the temporary buffer of its input at the last read
+    void sharing() {
+        const size_t none = (size_t)-1;
+        auto aliases = aliasing();
+        std::vector<size_t> def( registers_.size(), none );
+        auto last = last_reads();
+        std::map<size_t, std::vector<size_t>> loaded;
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            for (size_t j = op.in_; j < op.args_.size(); j++) {
+                def[ op.args_[j] ] = i;
+                for (auto slot : aliases[ op.args_[j] ]) {
+                    loaded[slot].push_back( op.args_[j] );
+                }
+            }
+        }
+
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            if ( op.kind_ != RegisterOp::Store && op.kind_ != RegisterOp::StaticStore ) {
+                continue;
+            }
+            op.readers_.clear();
+            for (auto r : loaded[op.v.slot_]) {
+                if ( def[r] < i && last[r] > i ) {
+                    op.readers_.push_back(r);
+                }
+            }
+            // arena buffers and fused results are written again before their next read
+            size_t r = op.args_[0];
+            bool temporary = false;
+            if ( def[r] != none ) {
+                RegisterOp& from = register_code_[ def[r] ];
+                temporary = from.buffer_ != nullptr;
+                temporary = temporary || from.kind_ == RegisterOp::Fused;
+            }
+            op.handover_ = temporary && last[r] == i && aliases[r].empty();
+        }
+    }
+
+    // register code as a dataflow graph: an operation depends on the writers of its registers,
+    // on earlier accesses of its hash slots and of its word instance, and sinks keep their order.
+    // Chains are paths without forks or joins, they are the tasks of parallel runs
+    void branching() {
+        const size_t none = (size_t)-1;
+        struct Access {
+            size_t writer = none;
+            std::vector<size_t> readers;
+        };
+        std::vector<std::set<size_t>> preds( register_code_.size() );
+        auto reading = [&preds, none](Access& a, size_t i) {
+            if ( a.writer != none ) {
+                preds[i].insert(a.writer);
+            }
+            a.readers.push_back(i);
+        };
+        auto writing = [&preds, none](Access& a, size_t i) {
+            if ( a.writer != none ) {
+                preds[i].insert(a.writer);
+            }
+            for (auto r : a.readers) {
+                if ( r != i ) {
+                    preds[i].insert(r);
+                }
+            }
+            a.writer = i;
+            a.readers.clear();
+        };
+        // words shared by several operations keep their outputs in the instance
+        auto instance = [](RegisterOp& op) -> const void* {
+            if ( op.kind_ == RegisterOp::Word ) {
+                return op.v.word_;
+            } else if ( op.kind_ == RegisterOp::Native ) {
+                return op.v.native_;
+            } else if ( op.kind_ == RegisterOp::Builtin || op.kind_ == RegisterOp::Fused ) {
+                return op.v.builtin_;
+            }
+            return nullptr;
+        };
+
+        // a register may point to the buffer of a slot, reading it is reading the slot: a later
+        // store waits for it, and only checks registers whose writers ran before ( see sharing )
+        auto aliases = aliasing();
+        std::vector<size_t> writer( registers_.size(), none );
+        std::map<size_t, Access> slots;
+        std::map<const void*, Access> instances;
+        size_t sink = none;
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            for (size_t j = 0; j < op.in_; j++) {
+                for (auto slot : aliases[ op.args_[j] ]) {
+                    reading(slots[slot], i);
+                }
+                size_t w = writer[ op.args_[j] ];
+                if ( w != none ) {
+                    preds[i].insert(w);
+                }
+                if ( w != none && instance(register_code_[w]) != nullptr ) {
+                    instances[ instance(register_code_[w]) ].readers.push_back(i);
+                }
+            }
+
+            bool builtin_op = op.kind_ == RegisterOp::Builtin || op.kind_ == RegisterOp::Fused;
+            BuiltinOperator* builtin = builtin_op ? op.v.builtin_ : nullptr;
+            if ( op.kind_ == RegisterOp::Load ) {
+                reading(slots[op.v.slot_], i);
+            } else if ( op.kind_ == RegisterOp::Store || op.kind_ == RegisterOp::StaticStore ) {
+                writing(slots[op.v.slot_], i);
+            } else if ( auto get = dynamic_cast<BuiltinSlotStaticGet*>(builtin) ) {
+                reading(slots[get->slot], i);
+            } else if ( auto fused = dynamic_cast<BuiltinFused*>(builtin) ) {
+                for (auto& f : fused->program) {
+                    if ( f.kind == BuiltinFused::Op::Load ) {
+                        reading(slots[f.slot], i);
+                    }
+                }
+            }
+
+            if ( instance(op) != nullptr ) {
+                writing(instances[ instance(op) ], i);
+            }
+            if ( op.kind_ == RegisterOp::Native && op.args_.size() == op.in_ ) {
+                if ( sink != none ) {
+                    preds[i].insert(sink);
+                }
+                sink = i;
+            }
+            for (size_t j = op.in_; j < op.args_.size(); j++) {
+                writer[ op.args_[j] ] = i;
+            }
+        }
+
+        std::vector<size_t> succs( register_code_.size(), 0 );
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            for (auto p : preds[i]) {
+                succs[p]++;
+            }
+        }
+
+        chains_.clear();
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            if ( preds[i].size() == 1 && succs[ *preds[i].begin() ] == 1 ) {
+                op.chain_ = register_code_[ *preds[i].begin() ].chain_;
+                continue;
+            }
+            op.chain_ = chains_.size();
+            chains_.push_back( Chain() );
+            std::set<size_t> deps;
+            for (auto p : preds[i]) {
+                deps.insert( register_code_[p].chain_ );
+            }
+            chains_.back().deps = deps.size();
+            for (auto d : deps) {
+                chains_[d].next.push_back( op.chain_ );
+            }
+        }
+    }
+
+    // operations are listed by chain again after steady state. An operation costs the samples of
+    // its longest operand, as found in the registers, threads pay off for two heavy chains
+    void scheduling() {
+        Cell* regs = registers_.data_.data();
+        for (auto& chain : chains_) {
+            chain.ops.clear();
+            chain.cost = 0;
+        }
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            Chain& chain = chains_[op.chain_];
+            chain.ops.push_back(i);
+            size_t cost = 1;
+            for (auto r : op.args_) {
+                if ( regs[r].is_vector() ) {
+                    cost = std::max(cost, (size_t)regs[r].vec()->size());
+                }
+            }
+            chain.cost += cost;
+        }
+        size_t heavy = 0;
+        for (auto& chain : chains_) {
+            if ( chain.cost >= parallel_cost_ ) {
+                heavy++;
+            }
+        }
+        parallel_ = heavy >= 2 && Workers::shared().threads() > 1;
+        if ( parallel_ ) {
+            Workers::shared().reserve( chains_.size() );
+        }
+        chain_stacks_.resize( chains_.size() );
+        for (auto& stack : chain_stacks_) {
+            if ( stack.capacity() < stack_.capacity() ) {
+                stack.reserve( stack_.capacity() );
+            }
+        }
+    }
+
+    // pure words moving their inputs only, like "a b -- b a"
+    bool is_shuffle(Enviroment& env, size_t idx) {
+        auto pick = picks_[idx];
+        if ( env.pure_words_.find( native_names_[idx] ) == env.pure_words_.end() ) {
+            return false;
+        }
+        for (auto c : pick->in_ + pick->out_) {
+            if ( c == 'n' || c == 's' || c == 'v' ) {
+                return false;
+            }
+        }
+        for (auto c : pick->out_) {
+            if ( pick->in_.find(c) == std::string::npos ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // steady state: after the init pass static words only repeat their results,
+    // they are replaced by constants and their arguments are not computed anymore
+    void steadying() {
+        if ( registered_ ) {
+            steadying_registers();
+            return;
+        }
+        for (size_t b = 0; b < binaries_.size(); b++) {
+            UserBinary out;
+            for (size_t i = 0; i < binaries_[b].size(); i++) {
+                steady_byte(binaries_[b][i], out);
+            }
+            binaries_[b] = out;
+        }
+        if ( peephole_ ) {
+            peephole();
+        }
+        if ( threaded_ ) {
+            threading();
+        }
+    }
+
+    bool steady_word(const WordByte& byte, size_t& args, std::vector<Cell>& outs) {
+        args = 0;
+        if ( byte.type_ == WordByte::Native ) {
+            auto word = dynamic_cast<StaticNativeWord*>( natives_[byte.idx_] );
+            return word != nullptr && word->started() && word->steady(args, outs);
+        }
+        if ( byte.type_ != WordByte::BuiltinOperator ) {
+            return false;
+        }
+
+        BuiltinOperator* op = builtins_[byte.idx_];
+        // a static word merged with its literal arguments by the peephole pass
+        if ( auto call = dynamic_cast<BuiltinCall*>(op) ) {
+            auto word = dynamic_cast<StaticNativeWord*>(call->native);
+            if ( word == nullptr || !word->started() || !word->steady(args, outs) || args < call->args.size() ) {
+                return false;
+            }
+            args = args - call->args.size();
+            return true;
+        }
+        if ( auto get = dynamic_cast<BuiltinSlotStaticGet*>(op) ) {
+            outs.push_back( Hash::Item2Cell(&get->value) );
+            return get->first;
+        }
+        if ( auto get = dynamic_cast<BuiltinStaticGet*>(op) ) {
+            args = 1;
+            outs.push_back( Hash::Item2Cell(&get->value) );
+            return get->first;
+        }
+        if ( auto sr = dynamic_cast<BuiltinSampleRate*>(op) ) {
+            outs.push_back( Cell( (TNT)sr->sr ) );
+            return sr->first;
+        }
+        if ( auto set = dynamic_cast<BuiltinSlotStaticSet*>(op) ) {
+            args = 1;
+            return set->first;
+        }
+        if ( auto set = dynamic_cast<BuiltinStaticSet*>(op) ) {
+            args = 2;
+            return set->first;
+        }
+        return false;
+    }
+
+    void steady_byte(const WordByte& byte, UserBinary& out) {
+        size_t args;
+        std::vector<Cell> outs;
+        if ( steady_word(byte, args, outs) == false ) {
+            out.push_back(byte);
+            return;
+        }
+
+        // arguments from literals and loads are removed with their pushes
+        for (size_t i = 0; i < args; i++) {
+            const WordByte* last = out.size() > 0 ? &out.back() : nullptr;
+            bool pure = last != nullptr && ( last->type_ == WordByte::Number || last->type_ == WordByte::String );
+            if ( last != nullptr && last->type_ == WordByte::BuiltinOperator ) {
+                auto op = builtins_[last->idx_];
+                pure = dynamic_cast<BuiltinSlotGet*>(op) || dynamic_cast<BuiltinConstant*>(op);
+            }
+            if ( pure ) {
+                out.pop_back();
+                continue;
+            }
+            if ( last != nullptr && last->type_ == WordByte::BuiltinOperator ) {
+                if ( auto drop = dynamic_cast<BuiltinDrop*>( builtins_[last->idx_] ) ) {
+                    drop->n++;
+                    continue;
+                }
+            }
+            out.push_back( peephole_builtin( verified_ ? new BuiltinDropRaw() : new BuiltinDrop() ) );
+        }
+
+        for (size_t i = 0; i < outs.size(); i++) {
+            if ( outs[i].is_number() ) {
+                out.push_back( WordByte(outs[i].num()) );
+                continue;
+            }
+            BuiltinConstant* op = verified_ ? new BuiltinConstantRaw() : new BuiltinConstant();
+            op->cell = outs[i];
+            out.push_back( peephole_builtin(op) );
+        }
+    }
+
+    // register code keeps the results of static words in their registers
+    void steadying_registers() {
+        Cell* regs = registers_.data_.data();
+        std::vector<RegisterOp> code;
+        for (size_t i = 0; i < register_code_.size(); i++) {
+            RegisterOp& op = register_code_[i];
+            size_t args;
+            std::vector<Cell> outs;
+            bool done = false;
+            if ( op.kind_ == RegisterOp::StaticStore ) {
+                done = op.first_;
+            } else if ( op.kind_ == RegisterOp::Builtin ) {
+                auto get = dynamic_cast<BuiltinSlotStaticGet*>(op.v.builtin_);
+                done = get != nullptr && get->first;
+            } else if ( op.kind_ == RegisterOp::Native ) {
+                auto word = dynamic_cast<StaticNativeWord*>(op.v.native_);
+                done = word != nullptr && word->started() && word->steady(args, outs);
+                for (size_t j = 0; done && j < outs.size(); j++) {
+                    regs[ op.args_[op.in_ + j] ] = outs[j];
+                }
+            }
+            if ( !done ) {
+                code.push_back(op);
+            }
+        }
+        register_code_ = code;
+        pruning();
+
+        if ( chains_.size() > 0 ) {
+            scheduling();
+        }
+    }
+
+    // pure operations whose results are not read anymore, liveness flows back
+    // from the impure ones to the writers of their inputs in one pass
+    void pruning() {
+        std::vector<RegisterOp> code;
+        code.swap(register_code_);
+        std::vector<std::vector<size_t>> writers( registers_.size() );
+        std::vector<bool> used( code.size(), false );
+        std::vector<size_t> work;
+        for (size_t i = 0; i < code.size(); i++) {
+            for (size_t j = code[i].in_; j < code[i].args_.size(); j++) {
+                writers[ code[i].args_[j] ].push_back(i);
+            }
+            if ( !code[i].pure_ ) {
+                used[i] = true;
+                work.push_back(i);
+            }
+        }
+        while ( work.size() > 0 ) {
+            size_t i = work.back();
+            work.pop_back();
+            for (size_t j = 0; j < code[i].in_; j++) {
+                for (auto w : writers[ code[i].args_[j] ]) {
+                    if ( !used[w] ) {
+                        used[w] = true;
+                        work.push_back(w);
+                    }
+                }
+            }
+        }
+        for (size_t i = 0; i < code.size(); i++) {
+            if ( used[i] ) {
+                register_code_.push_back( code[i] );
+            }
+        }
+        looping();
+    }
+
+    // peephole pass over stack code: no-op shuffles are removed, literals are merged into
+    // the following native call and frequent sequences become superinstructions
+    void peephole() {
+        // merging literals is the last pass, it would hide the other patterns
+        for (int merge = 0; merge < 2; merge++) {
+            for (size_t b = 0; b < binaries_.size(); b++) {
+                UserBinary out;
+                bool repeated = repeated_.find(b) != repeated_.end();
+                for (size_t i = 0; i < binaries_[b].size(); i++) {
+                    out.push_back( binaries_[b][i] );
+                    while ( peephole_tail(out, merge == 1, repeated) ) {
+                    }
+                }
+                binaries_[b] = out;
+            }
+        }
+    }
+
+    // rewriting the tail of the binary, rules are tried in order,
+    // superinstructions with a result buffer are not used in repeated binaries
+    bool peephole_tail(UserBinary& bin, bool merge, bool repeated) {
+        const size_t n = bin.size();
+        auto fire = [&](const char* pattern, size_t len) {
+            peephole_stats_[pattern]++;
+            bin.erase(bin.end() - len, bin.end());
+            return true;
+        };
+        auto native = [&](size_t back, const char* name) {
+            return n >= back && bin[n - back].type_ == WordByte::Native && native_names_[ bin[n - back].idx_ ] == name;
+        };
+        auto literal = [&](size_t i) {
+            return bin[i].type_ == WordByte::Number || bin[i].type_ == WordByte::String;
+        };
+
+        if ( native(2, "swap") && native(1, "swap") ) {
+            return fire("swap swap", 2);
+        }
+        if ( native(2, "dup") && native(1, "drop") ) {
+            return fire("dup drop", 2);
+        }
+        if ( native(3, "rot") && native(2, "rot") && native(1, "rot") ) {
+            return fire("rot rot rot", 3);
+        }
+        if ( n >= 2 && native(1, "drop") ) {
+            bool load = bin[n-2].type_ == WordByte::BuiltinOperator && dynamic_cast<BuiltinSlotGet*>( builtins_[bin[n-2].idx_] );
+            if ( literal(n-2) || load ) {
+                return fire("<literal> drop", 2);
+            }
+        }
+        if ( native(2, "swap") && native(1, "drop") ) {
+            fire("swap drop", 2);
+            bin.push_back( peephole_builtin( verified_ ? new BuiltinNipRaw() : new BuiltinNip() ) );
+            return true;
+        }
+        if ( !repeated && native(2, "dup") && native(1, "*") ) {
+            fire("dup *", 2);
+            bin.push_back( peephole_builtin( new BuiltinSquare() ) );
+            return true;
+        }
+        if ( merge && n >= 2 && bin[n-1].type_ == WordByte::Native && literal(n-2) ) {
+            BuiltinCall* call = verified_ ? new BuiltinCallRaw() : new BuiltinCall();
+            call->native = natives_[ bin[n-1].idx_ ];
+            size_t begin = n - 1;
+            while ( begin > 0 && literal(begin - 1) ) {
+                begin--;
+            }
+            for (size_t i = begin; i < n - 1; i++) {
+                if ( bin[i].type_ == WordByte::Number ) {
+                    call->args.push_back( Cell(bin[i].num_) );
+                } else {
+                    call->args.push_back( Cell(strings_[bin[i].idx_]) );
+                }
+            }
+            fire("<literal> native", n - begin);
+            bin.push_back( peephole_builtin(call) );
+            return true;
+        }
+        return false;
+    }
+
+    WordByte peephole_builtin(BuiltinOperator* op) {
+        size_t idx = builtins_.size();
+        builtins_.push_back(op);
+        return WordByte(WordByte::BuiltinOperator, idx);
+    }
+
+    void linking(Enviroment& env, UserWord& code) {
+        size_t bin_id = binaries_.size();
+        binaries_.push_back( UserBinary() );
+        if ( loop_instances(false).size() > 0 ) {
+            repeated_.insert(bin_id);
+        }
+
+        UserWord word = code;
+        if ( inline_ ) {
+            std::set<std::string> host;
+            if ( bin_id != 0 ) {
+                host = local_names(word);
+            }
+            word = inlining(env, word, host);
+        }
+        // a loop body shares the variables of its caller, so it can't look up names at run time
+        if ( !loop_ || has_dynamic_variable(word) ) {
+            word = unrolling(word);
+        } else {
+            word = unrolling(word, unroll_limit_);
+        }
+        if ( folding_ ) {
+            word = folding(env, word);
+        }
+
+        // variables with literal names are resolved to hash slots
+        bool resolved = !has_dynamic_variable(word);
+        auto locals = local_names(word);
+        auto early = early_reads(word);
+
+        UserBinary bin;
+        translating(env, word, 0, word.size(), bin_id, locals, early, resolved, bin);
+        binaries_[bin_id] = bin;
+    }
+
+    void translating(Enviroment& env, const UserWord& word, size_t begin, size_t end, size_t bin_id,
+                     const std::set<std::string>& locals, const std::set<size_t>& early, bool resolved, UserBinary& bin) {
+        for(size_t i = begin; i < end; i++) {
+            auto code = word[i];
+            if ( resolved && code.type_ == WordCode::String && i + 1 < end && is_variable_op(word[i+1]) ) {
+                const char* name = strings_[ string_id(code.str_) ];
+                const std::string& op_name = word[i+1].str_;
+
+                size_t level = bin_id;
+                bool fallback = false;
+                if ( op_name == "@" || op_name == "@~" ) {
+                    if ( locals.find(code.str_) == locals.end() ) {
+                        level = 0;
+                    } else if ( bin_id != 0 && early.find(i) != early.end() ) {
+                        // a static read runs once, before the word stored the name
+                        fallback = op_name == "@";
+                        level = fallback ? bin_id : 0;
+                    }
+                }
+                size_t slot = hash_.slot(level, name);
+
+                auto create = [&]() -> BuiltinOperator* {
+                    if ( op_name == "@" && fallback ) {
+                        return new BuiltinSlotFallbackGet(slot, hash_.slot(0, name));
+                    } else if ( op_name == "@" ) {
+                        return new BuiltinSlotGet(slot);
+                    } else if ( op_name == "@~" ) {
+                        return new BuiltinSlotStaticGet(slot);
+                    } else if ( op_name == "!" ) {
+                        return new BuiltinSlotSet(slot);
+                    }
+                    return new BuiltinSlotStaticSet(slot);
+                };
+                BuiltinOperator* op = create();
+
+                // static variables inside loops run once for every iteration
+                if ( op_name == "@~" || op_name == "!~" ) {
+                    auto loops = loop_instances(true);
+                    if ( loops.size() > 0 ) {
+                        LoopBuiltin* proxy = new LoopBuiltin();
+                        proxy->instances.push_back(op);
+                        proxy->counting(loops);
+                        while ( proxy->instances.size() < proxy->size() ) {
+                            proxy->instances.push_back( create() );
+                        }
+                        op = proxy;
+                    }
+                }
+                size_t idx = builtins_.size();
+                builtins_.push_back(op);
+                bin.push_back( WordByte( WordByte::BuiltinOperator, idx) );
+
+                i++;
+                continue;
+            }
+
+            switch( code.type_ ) {
+                case WordCode::Number :
+                    bin.push_back( WordByte( code.num_ ) );
+                    break;
+
+                case WordCode::String :
+                    bin.push_back( WordByte( WordByte::String, string_id( code.str_ ) ) );
+                    break;
+
+                case WordCode::Builtin :
+                    {
+                        BuiltinOperator* op = nullptr;
+                        if ( code.str_ == "@" ) {
+                            op = new BuiltinGet();
+                        } else if ( code.str_ == "@~" ) {
+                            op = new BuiltinStaticGet();
+                        } else if ( code.str_ == "!" ) {
+                            op = new BuiltinSet();
+                        } else if ( code.str_ == "!~" ) {
+                            op = new BuiltinStaticSet();
+                        } else if ( code.str_ == "sr" ) {
+                            op = new BuiltinSampleRate();
+                        } else if ( code.str_ == "%stage" ) {
+                            break;
+                        } else if ( code.str_.rfind("%stage.in ", 0) == 0 ) {
+                            op = new BuiltinStageInput( code.str_.substr(10) );
+                        } else if ( code.str_ == "%stage.out" ) {
+                            op = new BuiltinStageOutput();
+                        } else {
+                            lr_panic("Find an unsupoorted builtin operator!");
+                        }
+                        size_t idx = builtins_.size();
+                        builtins_.push_back(op);
+                        bin.push_back( WordByte( WordByte::BuiltinOperator, idx) );
+                    }
+                    break;
+
+                case WordCode::Native :
+                    {
+                        // stateful words own an instance for every loop iteration, pure words
+                        // only for iterations whose values are still alive together
+                        bool pure = env.pure_words_.find(code.str_) != env.pure_words_.end();
+                        auto loops = loop_instances(!pure);
+
+                        std::vector<NativeWord*> instances;
+                        instances.push_back( env.create_native(code.str_) );
+                        NativeWord* native = instances[0];
+                        if ( loops.size() > 0 ) {
+                            LoopNativeWord* proxy = new LoopNativeWord();
+                            proxy->counting(loops);
+                            while ( instances.size() < proxy->size() ) {
+                                instances.push_back( env.create_native(code.str_) );
+                            }
+                            native = proxy;
+                        }
+
+                        std::vector<Cell> args;
+                        bool bound = config_args(instances[0], bin, args);
+                        std::string key;
+                        if ( !pure && loops.size() == 0 ) {
+                            key = call_site(env, code.str_, bound, args);
+                        }
+                        NativeWord* adopted = adopting(key);
+                        if ( adopted != nullptr ) {
+                            delete instances[0];
+                            instances[0] = adopted;
+                            native = adopted;
+                        }
+                        if ( bound ) {
+                            binding(env, bin, instances, code.str_, args, adopted == nullptr);
+                        }
+                        if ( auto proxy = dynamic_cast<LoopNativeWord*>(native) ) {
+                            proxy->instances = instances;
+                        }
+
+                        bin.push_back( WordByte(WordByte::Native, natives_.size() ));
+                        natives_.push_back( native );
+                        native_names_.push_back( code.str_ );
+                        native_keys_.push_back( key );
+                        creators_.push_back( env.native_words_.find(code.str_)->second );
+                        bound_args_.push_back( bound ? std::optional(args) : std::nullopt );
+                    }
+                    break;
+
+                case WordCode::User :
+                    {
+                        bin.push_back( WordByte(WordByte::User, binaries_.size() ));
+                        UserWord& new_word = env.get_user( code.str_ );
+                        hash_.inc();
+                        linking(env, new_word);
+                    }
+                    break;
+
+                case WordCode::Loop :
+                    {
+                        size_t close = loop_end(word, i);
+                        bin.push_back( WordByte(WordByte::Loop, loops_.size()) );
+                        loops_.push_back( LoopCode() );
+
+                        LoopCode& loop = loops_.back();
+                        loop.slot = hash_.slot(0, strings_[ string_id(code.str_) ]);
+                        loop.begin = code.num_;
+                        loop.count = 0;
+                        for (TNT n = code.num_; n < word[close].num_; n = n + 1.0) {
+                            loop.count++;
+                        }
+                        loop.iteration = 0;
+                        loop.closed = closed_loop(env, word, i + 1, close);
+                        hash_.set(loop.slot, Hash::Item(loop.begin));
+
+                        // the body resolves names in the caller's scope, its own level stays empty
+                        loop.body = binaries_.size();
+                        binaries_.push_back( UserBinary() );
+                        hash_.inc();
+
+                        active_loops_.push_back(&loop);
+                        if ( loop_instances(false).size() > 0 ) {
+                            repeated_.insert(loop.body);
+                        }
+                        UserBinary body;
+                        translating(env, word, i + 1, close, bin_id, locals, early, resolved, body);
+                        active_loops_.pop_back();
+
+                        binaries_[loop.body] = body;
+                        i = close;
+                    }
+                    break;
+
+                case WordCode::LoopEnd :
+                    lr_panic("Find a loop ending without beginning!");
+                    break;
+            }
+        }
+    }
+
+    // loops an instance of a word is needed for, innermost first: stateful words for all of them,
+    // pure words up to a closed loop whose iterations consume their own values
+    std::vector<LoopCode*> loop_instances(bool stateful) {
+        std::vector<LoopCode*> loops;
+        for (size_t i = active_loops_.size(); i > 0; i--) {
+            if ( !stateful && active_loops_[i - 1]->closed ) {
+                break;
+            }
+            loops.push_back( active_loops_[i - 1] );
+        }
+        return loops;
+    }
+
+    // a closed body leaves the stack as it was without reading below it
+    static bool closed_loop(Enviroment& env, const UserWord& word, size_t begin, size_t end) {
+        size_t depth = 0;
+        for (size_t i = begin; i < end; i++) {
+            auto& code = word[i];
+            size_t in = 0;
+            size_t out = 1;
+            if ( code.type_ == WordCode::Builtin ) {
+                if ( code.str_ == "@" || code.str_ == "@~" ) {
+                    in = 1;
+                } else if ( code.str_ == "!" || code.str_ == "!~" ) {
+                    in = 2;
+                    out = 0;
+                }
+            } else if ( code.type_ == WordCode::Native ) {
+                auto sigs_it = env.native_signatures_.find(code.str_);
+                if ( sigs_it == env.native_signatures_.end() || sigs_it->second.size() == 0 ) {
+                    return false;
+                }
+                auto& sigs = sigs_it->second;
+                in = sigs[0].in_.size();
+                out = sigs[0].out_.size();
+                for (auto& sig : sigs) {
+                    if ( sig.in_.size() != in || sig.out_.size() != out ) {
+                        return false;
+                    }
+                }
+            } else if ( code.type_ == WordCode::Loop ) {
+                size_t close = loop_end(word, i);
+                if ( !closed_loop(env, word, i + 1, close) ) {
+                    return false;
+                }
+                i = close;
+                continue;
+            } else if ( code.type_ != WordCode::Number && code.type_ != WordCode::String ) {
+                return false;
+            }
+
+            if ( depth < in ) {
+                return false;
+            }
+            depth = depth - in + out;
+        }
+        return depth == 0;
+    }
+
+    static size_t loop_end(const UserWord& word, size_t begin) {
+        for (size_t i = begin + 1; i < word.size(); i++) {
+            if ( word[i].type_ == WordCode::LoopEnd && word[i].str_ == word[begin].str_ ) {
+                return i;
+            }
+        }
+        lr_panic("Find a loop without ending!");
+        return 0;
+    }
+
+    // expanding counted loops in place, reading the loop index becomes a number,
+    // a loop over limit codes once expanded is kept ( inner loops are expanded first )
+    static UserWord unrolling(const UserWord& word, size_t limit = SIZE_MAX) {
+        UserWord flat;
+        for (size_t i = 0; i < word.size(); i++) {
+            if ( word[i].type_ != WordCode::Loop ) {
+                flat.push_back( word[i] );
+                continue;
+            }
+            size_t close = loop_end(word, i);
+            UserWord body = unrolling( UserWord(word.begin() + i + 1, word.begin() + close), limit );
+            size_t count = 0;
+            for (TNT n = word[i].num_; n < word[close].num_; n = n + 1.0) {
+                count++;
+            }
+            if ( body.size() * count > limit ) {
+                flat.push_back( word[i] );
+                flat.insert(flat.end(), body.begin(), body.end());
+                flat.push_back( word[close] );
+                i = close;
+                continue;
+            }
+            for (TNT n = word[i].num_; n < word[close].num_; n = n + 1.0) {
+                for (size_t j = 0; j < body.size(); j++) {
+                    bool index = body[j].type_ == WordCode::String && body[j].str_ == word[i].str_;
+                    if ( index && j + 1 < body.size() && is_variable_op(body[j+1]) && body[j+1].str_ == "@" ) {
+                        flat.push_back( WordCode::new_number(n) );
+                        j++;
+                        continue;
+                    }
+                    flat.push_back( body[j] );
+                }
+            }
+            i = close;
+        }
+        return flat;
+    }
+
+    // configuration arguments of a word pushed as literals, at the end of the binary
+    bool config_args(NativeWord* native, const UserBinary& bin, std::vector<Cell>& args) {
+        auto word = dynamic_cast<ConfigNativeWord*>(native);
+        if ( !bind_ || word == nullptr || word->configs() > bin.size() ) {
+            return false;
+        }
+
+        const size_t n = word->configs();
+        for (size_t i = bin.size() - n; i < bin.size(); i++) {
+            if ( bin[i].type_ == WordByte::Number ) {
+                args.push_back( Cell(bin[i].num_) );
+            } else if ( bin[i].type_ == WordByte::String ) {
+                args.push_back( Cell(strings_[bin[i].idx_]) );
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // configuration arguments pushed as literals are bound to the word, and removed from the code,
+    // an adopted word is already configured
+    void binding(Enviroment& env, UserBinary& bin, const std::vector<NativeWord*>& instances, const std::string& name,
+                 const std::vector<Cell>& args, bool configure) {
+        const size_t n = args.size();
+        bin.erase(bin.end() - n, bin.end());
+        for (size_t i = 0; configure && i < instances.size(); i++) {
+            dynamic_cast<ConfigNativeWord*>(instances[i])->bind(args);
+        }
+
+        auto config_it = env.config_signatures_.find(name);
+        if ( config_it != env.config_signatures_.end() ) {
+            bound_signatures_[ natives_.size() ] = config_it->second(args);
+            return;
+        }
+
+        // the bound word checks the rest of its stack effect only
+        auto sigs_it = env.native_signatures_.find(name);
+        if ( sigs_it != env.native_signatures_.end() ) {
+            auto& sigs = bound_signatures_[ natives_.size() ];
+            for (auto sig : sigs_it->second) {
+                lr_assert(sig.in_.size() >= n, "Configuration arguments must be in the stack effect");
+                sig.in_.resize( sig.in_.size() - n );
+                if ( sig.rates_.size() > 0 ) {
+                    sig.rates_.resize( sig.in_.size() );
+                }
+                sig.fast_ = nullptr;
+                sigs.push_back(sig);
+            }
+        }
+    }
+
+    NativeWord* creating(size_t idx) {
+        NativeWord* native = creators_[idx](*creating_);
+        if ( bound_args_[idx].has_value() ) {
+            dynamic_cast<ConfigNativeWord*>(native)->bind( bound_args_[idx].value() );
+        }
+        return native;
+    }
+
+    // the copied runtime still points to the natives and builtins of the image
+    void cloning(Runtime& image) {
+        adopted_.clear();
+        carried_.clear();
+        interned_.clear();
+
+        std::map<const size_t*, const size_t*> iterations;
+        for (size_t k = 0; k < loops_.size(); k++) {
+            iterations[ &image.loops_[k].iteration ] = &loops_[k].iteration;
+        }
+
+        std::map<NativeWord*, NativeWord*> natives;
+        for (size_t i = 0; i < natives_.size(); i++) {
+            if ( auto proxy = dynamic_cast<LoopNativeWord*>(image.natives_[i]) ) {
+                LoopNativeWord* copy = new LoopNativeWord();
+                copy->counters = proxy->counters;
+                copy->total = proxy->total;
+                for (auto& c : copy->counters) {
+                    c.first = iterations[c.first];
+                }
+                for (auto instance : proxy->instances) {
+                    copy->instances.push_back( creating(i) );
+                    natives[instance] = copy->instances.back();
+                }
+                natives_[i] = copy;
+            } else {
+                natives_[i] = creating(i);
+            }
+            natives[ image.natives_[i] ] = natives_[i];
+        }
+
+        std::map<BuiltinOperator*, BuiltinOperator*> builtins;
+        for (size_t i = 0; i < builtins_.size(); i++) {
+            builtins_[i] = image.builtins_[i]->clone();
+            builtins[ image.builtins_[i] ] = builtins_[i];
+
+            std::vector<BuiltinOperator*> ops = { builtins_[i] };
+            if ( auto proxy = dynamic_cast<LoopBuiltin*>(builtins_[i]) ) {
+                for (auto& c : proxy->counters) {
+                    c.first = iterations[c.first];
+                }
+                auto origin = dynamic_cast<LoopBuiltin*>(image.builtins_[i]);
+                for (size_t k = 0; k < proxy->instances.size(); k++) {
+                    builtins[ origin->instances[k] ] = proxy->instances[k];
+                }
+                ops = proxy->instances;
+            }
+            for (auto op : ops) {
+                if ( auto call = dynamic_cast<BuiltinCall*>(op) ) {
+                    call->native = natives[call->native];
+                }
+            }
+        }
+
+        std::map<const Vec*, Vec*> buffers;
+        for (size_t k = 0; k < arena_.size(); k++) {
+            buffers[ &image.arena_[k] ] = &arena_[k];
+        }
+        for (auto& op : register_code_) {
+            if ( op.kind_ == RegisterOp::Word ) {
+                op.v.word_ = static_cast<RegisterWord*>( natives[op.v.word_] );
+            } else if ( op.kind_ == RegisterOp::Native ) {
+                op.v.native_ = natives[op.v.native_];
+            } else if ( op.kind_ == RegisterOp::Builtin || op.kind_ == RegisterOp::Fused ) {
+                op.v.builtin_ = builtins[op.v.builtin_];
+            }
+            if ( op.buffer_ != nullptr ) {
+                op.buffer_ = buffers[op.buffer_];
+            }
+        }
+
+        if ( threaded_ ) {
+            threading();
+        }
+    }
+
+    // a call site is a stateful word with its bound configuration, words typing may replace have none
+    static std::string call_site(Enviroment& env, const std::string& name, bool bound, const std::vector<Cell>& args) {
+        auto sigs_it = env.native_signatures_.find(name);
+        if ( !bound && sigs_it != env.native_signatures_.end() ) {
+            for (auto& sig : sigs_it->second) {
+                if ( sig.fast_ != nullptr ) {
+                    return "";
+                }
+            }
+        }
+
+        std::ostringstream ss;
+        ss << name;
+        if ( bound ) {
+            ss << std::hexfloat;
+            for (auto arg : args) {
+                if ( arg.is_number() ) {
+                    ss << "\n" << arg.num();
+                } else {
+                    ss << "\n\"" << arg.str();
+                }
+            }
+        }
+        return ss.str();
+    }
+
+    NativeWord* adopting(const std::string& key) {
+        auto it = adoptable_.find(key);
+        if ( key.size() == 0 || it == adoptable_.end() || it->second.size() == 0 ) {
+            return nullptr;
+        }
+        auto site = it->second.front();
+        it->second.pop_front();
+        adopted_.push_back( std::make_pair(natives_.size(), site.first) );
+        return site.second;
+    }
+
+    // global variables of both programs with the same name and type keep their values
+    void carrying(Runtime& previous) {
+        if ( !verified_ || !previous.verified_ ) {
+            return;
+        }
+        for (auto& g : previous.globals_) {
+            auto it = string_ids_.find( std::string_view(g.first) );
+            if ( g.first[0] == '%' || it == string_ids_.end() || !hash_.has(0, strings_[it->second]) ) {
+                continue;
+            }
+            size_t slot = hash_.slot(0, strings_[it->second]);
+            auto from = previous.slot_types_.find(g.second);
+            auto to = slot_types_.find(slot);
+            if ( from == previous.slot_types_.end() || to == slot_types_.end() || from->second != to->second ) {
+                continue;
+            }
+
+            Carry carry;
+            carry.from = g.second;
+            carry.to = slot;
+            carry.string = to->second == 's';
+            for (auto op : builtins_) {
+                std::vector<BuiltinOperator*> ops = { op };
+                if ( auto proxy = dynamic_cast<LoopBuiltin*>(op) ) {
+                    ops = proxy->instances;
+                }
+                for (auto o : ops) {
+                    auto set = dynamic_cast<BuiltinSlotStaticSet*>(o);
+                    if ( set != nullptr && set->slot == slot ) {
+                        carry.inits.push_back( &set->first );
+                    }
+                }
+            }
+            for (auto& op : register_code_) {
+                if ( op.kind_ == RegisterOp::StaticStore && op.v.slot_ == slot ) {
+                    carry.inits.push_back( &op.first_ );
+                }
+            }
+            carried_.push_back(carry);
+        }
+
+        // strings point into the pool of their program, which is freed with it: every string the
+        // previous program may hold is interned here, the swap only looks the pointer up
+        for (auto& c : carried_) {
+            if ( !c.string ) {
+                continue;
+            }
+            for (auto str : previous.strings_) {
+                interned_[str] = strings_[ string_id(str) ];
+            }
+            break;
+        }
+    }
+
+    // moving adopted words and carried variables out of the previous program, between two blocks
+    void take_over(Runtime& previous) {
+        for (auto& a : adopted_) {
+            previous.natives_[a.second] = nullptr;
+        }
+        for (auto& c : carried_) {
+            if ( !previous.hash_.valid(c.from) ) {
+                continue;
+            }
+            if ( c.string ) {
+                auto it = interned_.find( std::get<1>( previous.hash_.get(c.from) ) );
+                if ( it == interned_.end() ) {
+                    continue;
+                }
+                hash_.set(c.to, Hash::Item(it->second));
+            } else {
+                hash_.set(c.to, std::move( previous.hash_.get(c.from) ));
+            }
+            for (auto init : c.inits) {
+                *init = true;
+            }
+        }
+    }
+    // a program dropped before running gives adopted words back
+    void disown() {
+        for (auto& a : adopted_) {
+            natives_[a.first] = nullptr;
+        }
+    }
+
+    // static stack effect & type inference, types are the letters of WordSignature, '?' is unknown
+    struct TypeState {
+        std::vector<char> stack;
+        size_t depth;
+        std::map<size_t, char> slots;
+        std::vector<const WordSignature*> picks;
+        std::set<size_t> typed;
+        bool changed;
+        bool unknown;
+        bool strict;
+    };
+
+    bool typing(Enviroment& env) {
+        TypeState ts;
+        ts.picks.resize( natives_.size(), nullptr);
+        for (size_t i = 0; i < hash_.slots(); i++) {
+            if ( hash_.valid(i) ) {
+                const char kinds[] = "nsv";
+                ts.slots[i] = kinds[ hash_.get(i).index() ];
+            }
+        }
+
+        // variables carry types across runs, iterating until slot types are stable,
+        // then a strict pass rejects ill-typed programs
+        ts.strict = false;
+        for (int pass = 0; ; pass++) {
+            if ( pass == 8 ) {
+                return false;
+            }
+            ts.stack.clear();
+            ts.depth = 0;
+            ts.changed = false;
+            ts.unknown = false;
+            ts.typed.clear();
+
+            if ( typing_(env, 0, ts) == false ) {
+                return false;
+            }
+            if ( ts.changed == false ) {
+                break;
+            }
+        }
+
+        ts.strict = true;
+        ts.stack.clear();
+        ts.depth = 0;
+        ts.unknown = false;
+        ts.typed.clear();
+        if ( typing_(env, 0, ts) == false ) {
+            return false;
+        }
+        if ( ts.unknown || ts.stack.size() != 0 ) {
+            return false;
+        }
+
+        stack_.reserve( std::max(ts.depth, (size_t)1) );
+        for (size_t i = 0; i < natives_.size(); i++) {
+            if ( ts.picks[i] == nullptr || ts.picks[i]->fast_ == nullptr ) {
+                continue;
+            }
+            creators_[i] = ts.picks[i]->fast_;
+            if ( auto proxy = dynamic_cast<LoopNativeWord*>(natives_[i]) ) {
+                for (auto& native : proxy->instances) {
+                    delete native;
+                    native = ts.picks[i]->fast_(env);
+                }
+                continue;
+            }
+            delete natives_[i];
+            natives_[i] = ts.picks[i]->fast_(env);
+        }
+
+        picks_ = ts.picks;
+        slot_types_ = ts.slots;
+        return true;
+    }
+
+    // the stack depth of a verified program is known at every word, variable access skips the checks
+    void unchecking() {
+        for (size_t i = 0; i < builtins_.size(); i++) {
+            BuiltinOperator* op = builtins_[i];
+            if ( typeid(*op) == typeid(BuiltinSlotGet) ) {
+                builtins_[i] = new BuiltinSlotGetRaw( *static_cast<BuiltinSlotGet*>(op) );
+            } else if ( typeid(*op) == typeid(BuiltinSlotSet) ) {
+                builtins_[i] = new BuiltinSlotSetRaw( *static_cast<BuiltinSlotSet*>(op) );
+            } else {
+                continue;
+            }
+            delete op;
+        }
+    }
+
+    // fusing runs of element-wise vector words ( with their number and variable operands ) into one loop
+    void fusing(Enviroment& env) {
+        for (size_t b = 0; b < binaries_.size(); b++) {
+            // a fused result buffer would be shared by values of several iterations
+            if ( repeated_.find(b) != repeated_.end() ) {
+                continue;
+            }
+            UserBinary& bin = binaries_[b];
+            UserBinary fused;
+
+            size_t i = 0;
+            while ( i < bin.size() ) {
+                size_t end = i;
+                while ( end < bin.size() && fusion_item(env, bin[end]) ) {
+                    end++;
+                }
+                // region ends with a kernel, and must leave exact one value
+                while ( end > i && bin[end-1].type_ != WordByte::Native ) {
+                    end--;
+                }
+                size_t begin = i;
+                while ( begin < end && fusion_region(env, bin, begin, end) == false ) {
+                    begin++;
+                }
+                if ( begin == end ) {
+                    fused.push_back( bin[i] );
+                    i++;
+                    continue;
+                }
+
+                fused.insert( fused.end(), bin.begin() + i, bin.begin() + begin);
+
+                BuiltinFused* op = new BuiltinFused();
+                for (size_t j = begin; j < end; j++) {
+                    auto& byte = bin[j];
+                    BuiltinFused::Op fop;
+                    if ( byte.type_ == WordByte::Number ) {
+                        fop.kind = BuiltinFused::Op::Number;
+                        fop.num = byte.num_;
+                    } else if ( byte.type_ == WordByte::BuiltinOperator ) {
+                        fop.kind = BuiltinFused::Op::Load;
+                        fop.slot = dynamic_cast<BuiltinSlotGet*>( builtins_[byte.idx_] )->slot;
+                    } else {
+                        fop.kind = BuiltinFused::Op::Kernel;
+                        const std::string& name = native_names_[byte.idx_];
+                        fop.kernel = env.element_kernels_[name];
+                        if ( env.fast_math() && env.approx_kernels_.find(name) != env.approx_kernels_.end() ) {
+                            fop.kernel = env.approx_kernels_[name];
+                        }
+                        fop.arity = picks_[byte.idx_]->in_.size();
+                    }
+                    op->program.push_back(fop);
+                }
+                op->prepare();
+
+                size_t idx = builtins_.size();
+                builtins_.push_back(op);
+                fused.push_back( WordByte(WordByte::BuiltinOperator, idx) );
+                i = end;
+            }
+
+            bin = fused;
+        }
+    }
+
+    bool fusion_item(Enviroment& env, const WordByte& byte) {
+        if ( byte.type_ == WordByte::Number ) {
+            return true;
+        }
+        if ( byte.type_ == WordByte::BuiltinOperator ) {
+            auto get = dynamic_cast<BuiltinSlotGet*>( builtins_[byte.idx_] );
+            if ( get == nullptr ) {
+                return false;
+            }
+            char t = slot_types_[get->slot];
+            return t == 'n' || t == 'v';
+        }
+        if ( byte.type_ == WordByte::Native ) {
+            auto pick = picks_[byte.idx_];
+            if ( pick == nullptr || pick->out_ != "v" ) {
+                return false;
+            }
+            return env.element_kernels_.find( native_names_[byte.idx_] ) != env.element_kernels_.end();
+        }
+        return false;
+    }
+
+    bool fusion_region(Enviroment& env, const UserBinary& bin, size_t begin, size_t end) {
+        size_t depth = 0;
+        size_t kernels = 0;
+        for (size_t j = begin; j < end; j++) {
+            if ( bin[j].type_ != WordByte::Native ) {
+                depth++;
+                continue;
+            }
+            size_t arity = picks_[bin[j].idx_]->in_.size();
+            depth = depth >= arity ? depth - arity : 0;
+            depth++;
+            kernels++;
+        }
+        return depth == 1 && kernels >= 2;
+    }
+
+    bool typing_(Enviroment& env, size_t bin, TypeState& ts) {
+        for (size_t i = 0; i < binaries_[bin].size(); i++) {
+            auto& byte = binaries_[bin][i];
+            switch( byte.type_ ) {
+                case WordByte::Number:
+                    ts.stack.push_back('n');
+                    break;
+
+                case WordByte::String:
+                    ts.stack.push_back('s');
+                    break;
+
+                case WordByte::User:
+                    if ( typing_(env, byte.idx_, ts) == false ) {
+                        return false;
+                    }
+                    break;
+
+                case WordByte::Loop:
+                    {
+                        LoopCode& loop = loops_[byte.idx_];
+                        for (size_t k = 0; k < loop.count; k++) {
+                            if ( typing_(env, loop.body, ts) == false ) {
+                                return false;
+                            }
+                        }
+                    }
+                    break;
+
+                case WordByte::BuiltinOperator:
+                    {
+                        BuiltinOperator* op = loop_instance( builtins_[byte.idx_] );
+                        // cells crossing a pipeline boundary, typed by the stage before
+                        if ( auto in = dynamic_cast<BuiltinStageInput*>(op) ) {
+                            for (auto t : in->types) {
+                                ts.unknown = ts.unknown || t == '?';
+                                ts.stack.push_back(t);
+                            }
+                            break;
+                        }
+                        if ( auto out = dynamic_cast<BuiltinStageOutput*>(op) ) {
+                            out->types.assign( ts.stack.begin(), ts.stack.end() );
+                            ts.stack.clear();
+                            break;
+                        }
+
+                        size_t slot;
+                        if ( auto get = dynamic_cast<BuiltinSlotGet*>(op) ) {
+                            slot = get->slot;
+                        } else if ( auto sget = dynamic_cast<BuiltinSlotStaticGet*>(op) ) {
+                            slot = sget->slot;
+                        } else if ( auto set = dynamic_cast<BuiltinSlotSet*>(op) ) {
+                            slot = set->slot;
+                        } else if ( auto sset = dynamic_cast<BuiltinSlotStaticSet*>(op) ) {
+                            slot = sset->slot;
+                        } else {
+                            // variable names known only at run time, or a local read falling back to the global value
+                            return false;
+                        }
+
+                        bool load = dynamic_cast<BuiltinSlotGet*>(op) || dynamic_cast<BuiltinSlotStaticGet*>(op);
+                        if ( load ) {
+                            auto it = ts.slots.find(slot);
+                            if ( it == ts.slots.end() ) {
+                                ts.unknown = true;
+                                ts.stack.push_back('?');
+                            } else {
+                                ts.stack.push_back( it->second );
+                            }
+                            break;
+                        }
+
+                        if ( ts.stack.size() == 0 ) {
+                            if ( ts.strict ) {
+                                lr_panic("Type error: storing a variable from empty stack!");
+                            }
+                            ts.stack.push_back('?');
+                        }
+                        char t = ts.stack.back();
+                        ts.stack.pop_back();
+                        if ( t == '?' ) {
+                            break;
+                        }
+                        auto it = ts.slots.find(slot);
+                        if ( it == ts.slots.end() ) {
+                            ts.slots[slot] = t;
+                            ts.changed = true;
+                        } else if ( it->second != t ) {
+                            // a variable changing its type is checked at run time
+                            return false;
+                        }
+                    }
+                    break;
+
+                case WordByte::Native:
+                    if ( typing_native(env, byte.idx_, ts) == false ) {
+                        return false;
+                    }
+                    break;
+            }
+            ts.depth = std::max(ts.depth, ts.stack.size());
+        }
+        return true;
+    }
+
+    bool typing_native(Enviroment& env, size_t idx, TypeState& ts) {
+        const std::string& name = native_names_[idx];
+        auto sigs_it = env.native_signatures_.find(name);
+        auto bound_it = bound_signatures_.find(idx);
+        if ( bound_it == bound_signatures_.end() && sigs_it == env.native_signatures_.end() ) {
+            return false;
+        }
+        auto& sigs = bound_it == bound_signatures_.end() ? sigs_it->second : bound_it->second;
+
+        std::vector<const WordSignature*> matched;
+        std::vector<std::string> outs;
+        for (size_t i = 0; i < sigs.size(); i++) {
+            auto& sig = sigs[i];
+            if ( sig.in_.size() > ts.stack.size() ) {
+                continue;
+            }
+
+            bool ok = true;
+            std::map<char, char> vars;
+            size_t base = ts.stack.size() - sig.in_.size();
+            for (size_t j = 0; j < sig.in_.size() && ok; j++) {
+                char want = sig.in_[j];
+                char have = ts.stack[base + j];
+                if ( want == 'n' || want == 's' || want == 'v' ) {
+                    ok = (have == want || have == '?');
+                } else if ( vars.find(want) == vars.end() ) {
+                    vars[want] = have;
+                } else {
+                    ok = (vars[want] == have || have == '?' || vars[want] == '?');
+                }
+            }
+            if ( !ok ) {
+                continue;
+            }
+
+            std::string out;
+            for (size_t j = 0; j < sig.out_.size(); j++) {
+                char c = sig.out_[j];
+                if ( c == 'n' || c == 's' || c == 'v' ) {
+                    out.push_back(c);
+                } else {
+                    lr_assert(vars.find(c) != vars.end(), "Output type variable must appear in inputs!");
+                    out.push_back( vars[c] );
+                }
+            }
+            matched.push_back( &sig );
+            outs.push_back( out );
+        }
+
+        if ( matched.size() == 0 ) {
+            if ( ts.strict ) {
+                std::string msg = "Type error: stack can't match any signature of '" + name + "'";
+                if ( sigs.size() > 0 && sigs[0].in_.size() > ts.stack.size() ) {
+                    msg = "Type error: stack underflow at '" + name + "'";
+                }
+                lr_panic( msg.c_str() );
+            }
+            // slot types are not stable yet, going on with unknown types
+            size_t in_size = std::min(sigs[0].in_.size(), ts.stack.size());
+            ts.stack.resize( ts.stack.size() - in_size );
+            for (size_t i = 0; i < sigs[0].out_.size(); i++) {
+                ts.stack.push_back('?');
+            }
+            ts.unknown = true;
+            return true;
+        }
+
+        // with unknown inputs several signatures can match, merging their outputs
+        size_t in_size = matched[0]->in_.size();
+        std::string out = outs[0];
+        for (size_t i = 1; i < matched.size(); i++) {
+            if ( matched[i]->in_.size() != in_size || outs[i].size() != out.size() ) {
+                return false;
+            }
+            for (size_t j = 0; j < out.size(); j++) {
+                if ( outs[i][j] != out[j] ) {
+                    out[j] = '?';
+                }
+            }
+        }
+
+        // a word of a loop body must match the same signature in all iterations
+        const WordSignature* pick = nullptr;
+        if ( matched.size() == 1 ) {
+            pick = matched[0];
+        }
+        if ( ts.typed.find(idx) != ts.typed.end() && ts.picks[idx] != pick ) {
+            pick = nullptr;
+        }
+        ts.typed.insert(idx);
+        ts.picks[idx] = pick;
+
+        ts.stack.resize( ts.stack.size() - in_size );
+        for (size_t i = 0; i < out.size(); i++) {
+            ts.stack.push_back( out[i] );
+        }
+        return true;
+    }
+
+    // settings never stored by the program are constants of this Runtime
+    void find_constants(Enviroment& env, const UserWord& main_code) {
+        std::set<std::string> stored;
+        std::vector<const UserWord*> todo;
+        std::set<std::string> visited;
+        todo.push_back(&main_code);
+        while ( todo.size() > 0 ) {
+            const UserWord& word = *todo.back();
+            todo.pop_back();
+
+            if ( has_dynamic_variable(word) ) {
+                return;
+            }
+            auto locals = local_names(word);
+            stored.insert(locals.begin(), locals.end());
+
+            for (size_t i = 0; i < word.size(); i++) {
+                if ( word[i].type_ == WordCode::User && visited.find(word[i].str_) == visited.end() ) {
+                    visited.insert(word[i].str_);
+                    todo.push_back( &env.get_user(word[i].str_) );
+                }
+            }
+        }
+
+        for (auto& m : env.script_settings()) {
+            if ( stored.find(m.first) != stored.end() ) {
+                continue;
+            }
+            auto value = m.second;
+            if ( value.index() == 0 ) {
+                constants_[m.first] = (TNT)std::get<0>(value);
+            } else if ( value.index() == 1 ) {
+                constants_[m.first] = (TNT)std::get<1>(value);
+            } else {
+                constants_[m.first] = std::get<2>(value);
+            }
+        }
+    }
+
+    // evaluating pure words on constant operands, running the word itself on a scratch stack
+    UserWord folding(Enviroment& env, const UserWord& word) {
+        UserWord out;
+        for (size_t i = 0; i < word.size(); i++) {
+            auto& code = word[i];
+            if ( code.type_ == WordCode::String && i + 1 < word.size() && is_variable_op(word[i+1]) ) {
+                if ( (word[i+1].str_ == "@" || word[i+1].str_ == "@~") && constants_.find(code.str_) != constants_.end() ) {
+                    out.push_back( WordCode::new_number( constants_[code.str_] ) );
+                    i++;
+                    continue;
+                }
+            }
+
+            if ( code.type_ == WordCode::Native && env.pure_words_.find(code.str_) != env.pure_words_.end() ) {
+                // arity of the all numbers overload
+                std::optional<size_t> arity;
+                for (auto& sig : env.native_signatures_[code.str_]) {
+                    if ( sig.in_.find_first_of("sv") == std::string::npos ) {
+                        arity = sig.in_.size();
+                        break;
+                    }
+                }
+
+                bool constant = arity.has_value() && out.size() >= arity.value();
+                for (size_t j = 0; constant && j < arity.value(); j++) {
+                    constant = out[out.size() - 1 - j].type_ == WordCode::Number;
+                }
+
+                if ( constant ) {
+                    Stack scratch;
+                    for (size_t j = out.size() - arity.value(); j < out.size(); j++) {
+                        scratch.push_number( out[j].num_ );
+                    }
+                    NativeWord* native = env.create_native(code.str_);
+                    native->run(scratch);
+                    delete native;
+
+                    std::vector<TNT> results;
+                    while ( scratch.size() > 0 && scratch.top().is_number() ) {
+                        results.insert(results.begin(), scratch.pop_number());
+                    }
+                    if ( scratch.size() == 0 ) {
+                        out.resize( out.size() - arity.value() );
+                        for (size_t j = 0; j < results.size(); j++) {
+                            out.push_back( WordCode::new_number(results[j]) );
+                        }
+                        continue;
+                    }
+                }
+            }
+
+            out.push_back(code);
+        }
+        return out;
+    }
+
+    // inlining user words into caller, every call site gets its own variable scope
+    static bool is_variable_op(const WordCode& code) {
+        if ( code.type_ != WordCode::Builtin ) {
+            return false;
+        }
+        return code.str_ == "@" || code.str_ == "@~" || code.str_ == "!" || code.str_ == "!~";
+    }
+
+    static std::set<std::string> local_names(const UserWord& word) {
+        std::set<std::string> names;
+        for (size_t i = 1; i < word.size(); i++) {
+            if ( word[i].type_ == WordCode::Builtin && (word[i].str_ == "!" || word[i].str_ == "!~") ) {
+                if ( word[i-1].type_ == WordCode::String ) {
+                    names.insert( word[i-1].str_ );
+                }
+            }
+        }
+        return names;
+    }
+
+    static bool has_dynamic_variable(const UserWord& word) {
+        for (size_t i = 0; i < word.size(); i++) {
+            if ( is_variable_op(word[i]) ) {
+                if ( i == 0 || word[i-1].type_ != WordCode::String ) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // reads of a local name before any store of it, the global value is found there
+    static std::set<size_t> early_reads(const UserWord& word) {
+        std::set<std::string> stored;
+        std::set<size_t> early;
+        early_reads_(word, 0, word.size(), local_names(word), stored, early);
+        return early;
+    }
+    static void early_reads_(const UserWord& word, size_t begin, size_t end, const std::set<std::string>& locals,
+                             std::set<std::string>& stored, std::set<size_t>& early) {
+        for (size_t i = begin; i < end; i++) {
+            if ( word[i].type_ == WordCode::Loop ) {
+                // stores of a loop which never runs don't count after it
+                size_t close = loop_end(word, i);
+                if ( word[i].num_ < word[close].num_ ) {
+                    early_reads_(word, i + 1, close, locals, stored, early);
+                } else {
+                    std::set<std::string> skipped = stored;
+                    early_reads_(word, i + 1, close, locals, skipped, early);
+                }
+                i = close;
+                continue;
+            }
+            if ( word[i].type_ != WordCode::String || i + 1 >= end || !is_variable_op(word[i+1]) ) {
+                continue;
+            }
+            auto& name = word[i].str_;
+            if ( word[i+1].str_ == "!" || word[i+1].str_ == "!~" ) {
+                stored.insert(name);
+            } else if ( locals.find(name) != locals.end() && stored.find(name) == stored.end() ) {
+                early.insert(i);
+            }
+        }
+    }
+
+    static bool can_inline(const UserWord& word, const std::set<std::string>& host) {
+        // an early read is local or global depending on earlier calls, the word keeps its own level
+        if ( early_reads(word).size() > 0 ) {
+            return false;
+        }
+        auto locals = local_names(word);
+        for (size_t i = 0; i < word.size(); i++) {
+            if ( !is_variable_op(word[i]) ) {
+                continue;
+            }
+            // variable name must be known at link time
+            if ( i == 0 || word[i-1].type_ != WordCode::String ) {
+                return false;
+            }
+            // global access can't be shadowed by host's local variables
+            auto& name = word[i-1].str_;
+            if ( locals.find(name) == locals.end() && host.find(name) != host.end() ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    UserWord inlining(Enviroment& env, const UserWord& word, const std::set<std::string>& host) {
+        UserWord flat;
+        for (size_t i = 0; i < word.size(); i++) {
+            if ( word[i].type_ != WordCode::User ) {
+                flat.push_back( word[i] );
+                continue;
+            }
+
+            UserWord& callee = env.get_user( word[i].str_ );
+            if ( !can_inline(callee, host) ) {
+                flat.push_back( word[i] );
+                continue;
+            }
+
+            std::string scope = word[i].str_ + "#" + std::to_string(inlined_) + "/";
+            inlined_++;
+
+            auto locals = local_names(callee);
+            UserWord body = callee;
+            for (size_t j = 0; j + 1 < body.size(); j++) {
+                if ( body[j].type_ == WordCode::String && is_variable_op(body[j+1]) ) {
+                    if ( locals.find( body[j].str_ ) != locals.end() ) {
+                        body[j].str_ = scope + body[j].str_;
+                    }
+                }
+            }
+
+            body = inlining(env, body, host);
+            flat.insert(flat.end(), body.begin(), body.end());
+        }
+        return flat;
+    }
+
+    // interned strings, equal names share one pointer ( hash levels are keyed by it )
+    size_t string_id(const std::string& str) {
+        auto it = string_ids_.find(str);
+        if ( it != string_ids_.end() ) {
+            return it->second;
+        }
+
+        size_t ret = strings_.size();
+
+        string_pool_->push_back(str);
+        const char* new_str = string_pool_->back().c_str();
+        strings_.push_back(new_str);
+        string_ids_[ std::string_view(new_str, str.length()) ] = ret;
+
+        return ret;
+    }
+
+    struct BuiltinGet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinGet)
+        Hash::Item value;
+        virtual void run(Stack& stack, Hash& hash) {
+            const char* name = stack.pop_string();
+            value = hash.find(name);
+            stack.push( Hash::Item2Cell(&value) );
+        }
+    };
+
+    struct BuiltinStaticGet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinStaticGet)
+        Hash::Item value;
+        bool first;
+        BuiltinStaticGet() {
+            first = false;
+        }
+        virtual void run(Stack& stack, Hash& hash) {
+            if ( first == false) {
+                first = true;
+                const char* name = stack.pop_string();
+
+                value = hash.find(name);
+                stack.push( Hash::Item2Cell(&value) );
+                return;
+            }
+            stack.pop_string();
+            stack.push( Hash::Item2Cell(&value) );
+        }
+    };
+
+    struct BuiltinSet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSet)
+        virtual void run(Stack& stack, Hash& hash) {
+            const char* name = stack.pop_string();
+            Cell cell = stack.pop();
+            hash.store(name, cell, stack);
+        }
+    };
+
+    struct BuiltinStaticSet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinStaticSet)
+        bool first;
+        BuiltinStaticSet() {
+            first = false;
+        }
+        virtual void run(Stack& stack, Hash& hash) {
+            if ( first == false) {
+                first = true;
+                const char* name = stack.pop_string();
+                Cell cell = stack.pop();
+                hash.store(name, cell, stack);
+                return;
+            }
+            stack.pop_string();
+            stack.pop();
+        }
+    };
+
+    // variable access resolved to a hash slot at link time
+    struct BuiltinSlotGet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSlotGet)
+        size_t slot;
+        BuiltinSlotGet(size_t s) : slot(s) {}
+        virtual void run(Stack& stack, Hash& hash) {
+            stack.push( Hash::Item2Cell( &hash.get(slot) ) );
+        }
+    };
+
+    // a local read before the word stored the name, the global value is read until it does
+    struct BuiltinSlotFallbackGet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSlotFallbackGet)
+        size_t slot;
+        size_t global;
+        BuiltinSlotFallbackGet(size_t s, size_t g) : slot(s), global(g) {}
+        virtual void run(Stack& stack, Hash& hash) {
+            size_t s = hash.valid(slot) ? slot : global;
+            stack.push( Hash::Item2Cell( &hash.get(s) ) );
+        }
+    };
+
+    struct BuiltinSlotStaticGet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSlotStaticGet)
+        size_t slot;
+        Hash::Item value;
+        bool first;
+        BuiltinSlotStaticGet(size_t s) : slot(s) {
+            first = false;
+        }
+        virtual void run(Stack& stack, Hash& hash) {
+            if ( first == false) {
+                first = true;
+                value = hash.get(slot);
+            }
+            stack.push( Hash::Item2Cell(&value) );
+        }
+    };
+
+    struct BuiltinSlotSet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSlotSet)
+        size_t slot;
+        BuiltinSlotSet(size_t s) : slot(s) {}
+        virtual void run(Stack& stack, Hash& hash) {
+            Cell cell = stack.pop();
+            hash.store(slot, cell, stack);
+        }
+    };
+
+    struct BuiltinSlotStaticSet : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSlotStaticSet)
+        size_t slot;
+        bool first;
+        BuiltinSlotStaticSet(size_t s) : slot(s) {
+            first = false;
+        }
+        virtual void run(Stack& stack, Hash& hash) {
+            if ( first == false) {
+                first = true;
+                Cell cell = stack.pop();
+                hash.store(slot, cell, stack);
+                return;
+            }
+            stack.pop();
+        }
+    };
+
+    // a fused element-wise expression, evaluated chunk by chunk so temporaries stay in L1
+    struct BuiltinFused : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinFused)
+        static constexpr size_t CHUNK = 256;
+        struct Op {
+            enum {
+                Input,
+                Number,
+                Load,
+                Kernel,
+            } kind;
+            TNT num;
+            size_t slot;
+            ElementKernel* kernel;
+            size_t arity;
+        };
+        std::vector<Op> program;
+        size_t inputs;
+        Vec result;
+
+        std::vector<Cell> cells;
+        std::vector<TNT> temps;
+        std::vector<ElementArg> args;
+
+        // cells consumed from the stack below the region become input operations
+        void prepare() {
+            std::vector<Op> full;
+            size_t depth = 0;
+            inputs = 0;
+            for (size_t i = 0; i < program.size(); i++) {
+                if ( program[i].kind == Op::Kernel && depth < program[i].arity ) {
+                    inputs += program[i].arity - depth;
+                    depth = program[i].arity;
+                }
+                depth = program[i].kind == Op::Kernel ? depth - program[i].arity + 1 : depth + 1;
+            }
+            for (size_t i = 0; i < inputs; i++) {
+                Op op;
+                op.kind = Op::Input;
+                op.slot = i;
+                full.push_back(op);
+            }
+            full.insert(full.end(), program.begin(), program.end());
+            program = full;
+
+            cells.resize( program.size() );
+            temps.resize( program.size() * CHUNK );
+            args.resize( program.size() );
+        }
+
+        virtual void run(Stack& stack, Hash& hash) {
+            for (size_t i = 0; i < inputs; i++) {
+                cells[inputs - 1 - i] = stack.pop();
+            }
+            compute(hash, result);
+            stack.push_vector(&result);
+        }
+        // register code: operands are read from the registers, the result goes to an arena buffer
+        void run(Cell* regs, const size_t* args, Hash& hash, Vec* out) {
+            if ( out == nullptr ) {
+                out = &result;
+            }
+            for (size_t i = 0; i < inputs; i++) {
+                cells[i] = regs[ args[i] ];
+            }
+            compute(hash, *out);
+            regs[ args[inputs] ] = Cell(out);
+        }
+
+        void compute(Hash& hash, Vec& result) {
+            // collecting operands, vector operands define the block shape
+            const Vec* shape = nullptr;
+            for (size_t i = inputs; i < program.size(); i++) {
+                if ( program[i].kind == Op::Load ) {
+                    cells[i] = Hash::Item2Cell( &hash.get(program[i].slot) );
+                }
+            }
+            for (size_t i = 0; i < program.size(); i++) {
+                bool operand = program[i].kind == Op::Input || program[i].kind == Op::Load;
+                if ( operand && cells[i].is_vector() ) {
+                    if ( shape == nullptr ) {
+                        shape = cells[i].vec();
+                    }
+                    lr_check( cells[i].vec()->size() == shape->size(), "Fused vector words need same size vectors!");
+                }
+            }
+            lr_check(shape != nullptr, "Fused vector words need a vector!");
+            if ( result.rows() != shape->rows() || result.cols() != shape->cols() ) {
+                result.resize( shape->rows(), shape->cols() );
+            }
+
+            const size_t n = shape->size();
+            for (size_t offset = 0; offset < n; offset += CHUNK) {
+                size_t len = std::min(CHUNK, n - offset);
+                size_t top = 0;
+                for (size_t i = 0; i < program.size(); i++) {
+                    auto& op = program[i];
+                    if ( op.kind == Op::Kernel ) {
+                        ElementArg a = args[top - 1];
+                        ElementArg b = op.arity == 2 ? args[top - 2] : a;
+                        top = top - op.arity;
 
-                case WordCode::Builtin :
-                    {
-                        BuiltinOperator* op = nullptr;
-                        if ( code.str_ == "@" ) {
-                            op = new BuiltinGet();
-                        } else if ( code.str_ == "@~" ) {
-                            op = new BuiltinStaticGet();
-                        } else if ( code.str_ == "!" ) {
-                            op = new BuiltinSet();
-                        } else if ( code.str_ == "!~" ) {
-                            op = new BuiltinStaticSet();
-                        } else if ( code.str_ == "sr" ) {
-                            op = new BuiltinSampleRate();
-                        } else {
-                            lr_panic("Find an unsupoorted builtin operator!");
+                        TNT* out = temps.data() + top * CHUNK;
+                        if ( i == program.size() - 1 ) {
+                            out = result.data() + offset;
                         }
-                        size_t idx = builtins_.size();
-                        builtins_.push_back(op);
-                        bin.push_back( WordByte( WordByte::BuiltinOperator, idx) );
+                        op.kernel(out, a, b, len);
+                        args[top].data_ = out;
+                        args[top].scalar_ = false;
+                        top++;
+                        continue;
                     }
-                    break;
 
-                case WordCode::Native :
-                    bin.push_back( WordByte(WordByte::Native, natives_.size() ));
-                    natives_.push_back( env.create_native(code.str_));
-                    break;
+                    const Cell* cell = nullptr;
+                    if ( op.kind == Op::Input || op.kind == Op::Load ) {
+                        cell = &cells[i];
+                    }
+                    if ( cell == nullptr ) {
+                        args[top].data_ = &op.num;
+                        args[top].scalar_ = true;
+                    } else if ( cell->type() == Cell::T_Number ) {
+                        temps[top * CHUNK] = cell->num();
+                        args[top].data_ = temps.data() + top * CHUNK;
+                        args[top].scalar_ = true;
+                    } else {
+                        args[top].data_ = cell->vec()->data() + offset;
+                        args[top].scalar_ = false;
+                    }
+                    top++;
+                }
+            }
+        }
+    };
 
-                case WordCode::User :
-                    bin.push_back( WordByte(WordByte::User, binaries_.size() ));
-                    UserWord& new_word = env.get_user( code.str_ );
-                    hash_.inc();
-                    linking(env, new_word);
-                    break;
+    // superinstructions of the peephole pass
+    struct BuiltinNip : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinNip)
+        virtual void run(Stack& stack, Hash& hash) {
+            Cell a = stack.pop();
+            stack.drop();
+            stack.push(a);
+        }
+    };
+
+    struct BuiltinSquare : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSquare)
+        Vec result;
+        virtual void run(Stack& stack, Hash& hash) {
+            if ( stack.top().is_number() ) {
+                TNT a = stack.pop_number();
+                stack.push_number(a * a);
+                return;
             }
+            const Vec* a = stack.pop_vector();
+            result = *a * *a;
+            stack.push_vector(&result);
         }
+    };
 
-        binaries_[bin_id] = bin;
-    }
+    // steady state results of static words
+    struct BuiltinConstant : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinConstant)
+        Cell cell;
+        virtual void run(Stack& stack, Hash& hash) {
+            stack.push(cell);
+        }
+    };
 
-    size_t string_id(const std::string& str) {
-        for (size_t i = 0; i < strings_.size(); i++) {
-            if ( strcmp(strings_[i], str.c_str()) == 0 ) {
-                return i;
+    struct BuiltinDrop : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinDrop)
+        size_t n;
+        BuiltinDrop() {
+            n = 1;
+        }
+        virtual void run(Stack& stack, Hash& hash) {
+            for (size_t i = 0; i < n; i++) {
+                stack.drop();
             }
         }
+    };
 
-        size_t ret = strings_.size();
+    struct BuiltinCall : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinCall)
+        std::vector<Cell> args;
+        NativeWord* native;
+        virtual void run(Stack& stack, Hash& hash) {
+            for (size_t i = 0; i < args.size(); i++) {
+                stack.push( args[i] );
+            }
+            native->run(stack);
+        }
+    };
 
-        char* new_str = new char[ str.length() + 1];
-        strcpy(new_str, str.c_str() );
-        strings_.push_back(new_str);
+    // the same builtins with unchecked stack access, a verified program never leaves the stack bounds
+    struct BuiltinSlotGetRaw : public BuiltinSlotGet {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSlotGetRaw)
+        BuiltinSlotGetRaw(const BuiltinSlotGet& op) : BuiltinSlotGet(op) {}
+        virtual void run(Stack& stack, Hash& hash) {
+            stack.raw_push( Hash::Item2Cell( &hash.get(slot) ) );
+        }
+    };
 
-        return ret;
-    }
+    struct BuiltinSlotSetRaw : public BuiltinSlotSet {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSlotSetRaw)
+        BuiltinSlotSetRaw(const BuiltinSlotSet& op) : BuiltinSlotSet(op) {}
+        virtual void run(Stack& stack, Hash& hash) {
+            Cell cell = stack.raw_pop();
+            hash.store(slot, cell, stack);
+        }
+    };
 
-    struct BuiltinGet : public BuiltinOperator {
-        Hash::Item value;
+    struct BuiltinNipRaw : public BuiltinNip {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinNipRaw)
         virtual void run(Stack& stack, Hash& hash) {
-            const char* name = stack.pop_string();
-            value = hash.find(name);
-            stack.push( Hash::Item2Cell(&value) );
+            Cell a = stack.raw_pop();
+            stack.raw_top() = a;
         }
     };
 
-    struct BuiltinStaticGet : public BuiltinOperator {
-        Hash::Item value;
-        bool first;
-        BuiltinStaticGet() {
-            first = false;
+    struct BuiltinConstantRaw : public BuiltinConstant {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinConstantRaw)
+        virtual void run(Stack& stack, Hash& hash) {
+            stack.raw_push(cell);
         }
+    };
+
+    struct BuiltinDropRaw : public BuiltinDrop {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinDropRaw)
         virtual void run(Stack& stack, Hash& hash) {
-            if ( first == false) {
-                first = true;
-                const char* name = stack.pop_string();
+            stack.raw_drop(n);
+        }
+    };
 
-                value = hash.find(name);
-                stack.push( Hash::Item2Cell(&value) );
-                return;
+    struct BuiltinCallRaw : public BuiltinCall {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinCallRaw)
+        virtual void run(Stack& stack, Hash& hash) {
+            for (size_t i = 0; i < args.size(); i++) {
+                stack.raw_push( args[i] );
             }
-            stack.pop_string();
-            stack.push( Hash::Item2Cell(&value) );
+            native->run(stack);
         }
     };
 
-    struct BuiltinSet : public BuiltinOperator {
+    // a stateful word or static variable inside counted loops, every iteration owns an instance
+    template<typename T>
+    struct LoopInstances {
+        std::vector<T*> instances;
+        std::vector< std::pair<const size_t*, size_t> > counters;
+        size_t total;
+
+        LoopInstances() {
+            total = 1;
+        }
+        ~LoopInstances() {
+            for (size_t i = 0; i < instances.size(); i++) {
+                delete instances[i];
+            }
+        }
+        void counting(const std::vector<LoopCode*>& loops) {
+            total = 1;
+            for (auto loop : loops) {
+                counters.push_back( {&loop->iteration, total} );
+                total = total * loop->count;
+            }
+        }
+        // empty loops still keep one instance
+        size_t size() {
+            return std::max(total, (size_t)1);
+        }
+        T* current() {
+            size_t k = 0;
+            for (auto& c : counters) {
+                k += *c.first * c.second;
+            }
+            return instances[k];
+        }
+    };
+
+    struct LoopNativeWord : public NativeWord, public LoopInstances<NativeWord> {
+        virtual void run(Stack& stack) {
+            current()->run(stack);
+        }
+    };
+
+    struct LoopBuiltin : public BuiltinOperator, public LoopInstances<BuiltinOperator> {
         virtual void run(Stack& stack, Hash& hash) {
-            const char* name = stack.pop_string();
-            Cell cell = stack.pop();
-            hash.set(name, Hash::Cell2Item(cell));
+            current()->run(stack, hash);
+        }
+        virtual BuiltinOperator* clone() {
+            LoopBuiltin* copy = new LoopBuiltin();
+            copy->counters = counters;
+            copy->total = total;
+            for (auto op : instances) {
+                copy->instances.push_back( op->clone() );
+            }
+            return copy;
         }
     };
 
-    struct BuiltinStaticSet : public BuiltinOperator {
-        bool first;
-        BuiltinStaticSet() {
-            first = false;
+    static NativeWord* loop_instance(NativeWord* native) {
+        if ( auto proxy = dynamic_cast<LoopNativeWord*>(native) ) {
+            return proxy->current();
+        }
+        return native;
+    }
+    static BuiltinOperator* loop_instance(BuiltinOperator* op) {
+        if ( auto proxy = dynamic_cast<LoopBuiltin*>(op) ) {
+            return proxy->current();
+        }
+        return op;
+    }
+
+    // cells handed over by the stage before in a pipeline, they live in the queue block
+    struct BuiltinStageInput : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinStageInput)
+        std::string types;
+        const std::vector<Cell>* cells;
+        BuiltinStageInput(const std::string& t) : types(t) {
+            cells = nullptr;
         }
         virtual void run(Stack& stack, Hash& hash) {
-            if ( first == false) {
-                first = true;
-                const char* name = stack.pop_string();
-                Cell cell = stack.pop();
-                hash.set(name, Hash::Cell2Item(cell));
-                return;
+            for (auto& cell : *cells) {
+                stack.push(cell);
+            }
+        }
+    };
+
+    // the whole stack at the end of a stage, copied into the queue by the pipeline
+    struct BuiltinStageOutput : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinStageOutput)
+        std::string types;
+        std::vector<Cell> cells;
+        virtual void run(Stack& stack, Hash& hash) {
+            cells.resize( stack.size() );
+            for (size_t i = cells.size(); i > 0; i--) {
+                cells[i - 1] = stack.pop();
             }
-            stack.pop_string();
-            stack.pop();
         }
     };
 
     struct BuiltinSampleRate : public BuiltinOperator {
+        BUILTIN_CLONE_DEFINE_LR(BuiltinSampleRate)
         int sr;
         bool first;
         BuiltinSampleRate() {
@@ -971,32 +4657,464 @@ private:
     Stack stack_;
     Hash hash_;
 
-    // resource
+    // resource, the characters of interned strings are shared with clones
+    std::shared_ptr<std::deque<std::string>> string_pool_;
     std::vector<const char*> strings_;
+    std::unordered_map<std::string_view, size_t> string_ids_;
 
     std::vector<UserBinary> binaries_;
     std::vector<NativeWord*> natives_;
     std::vector<BuiltinOperator*> builtins_;
+    size_t block_size_;
+
+    std::vector<std::string> native_names_;
+    bool verified_;
+    std::vector<const WordSignature*> picks_;
+    std::map<size_t, char> slot_types_;
+
+    bool inline_;
+    size_t inlined_;
+    bool folding_;
+    bool bind_;
+    std::map<size_t, std::vector<WordSignature>> bound_signatures_;
+    std::map<std::string, TNT> constants_;
+
+    bool threaded_;
+    std::vector<ThreadedBinary> threaded_binaries_;
+
+    bool registered_;
+    Stack registers_;
+    std::vector<RegisterOp> register_code_;
+    std::deque<Vec> arena_;
+
+    size_t decimation_;
+    size_t phase_;
+    std::vector<Ramp> ramps_;
+
+    // dataflow chains of register code, a parallel run starts a chain when its inputs are done
+    struct Chain {
+        std::vector<size_t> ops;
+        std::vector<size_t> next;
+        size_t deps;
+        size_t cost;
+    };
+    bool parallel_;
+    size_t parallel_cost_;
+    std::vector<Chain> chains_;
+    std::vector<Stack> chain_stacks_;
+
+    bool peephole_;
+    std::map<std::string, size_t> peephole_stats_;
+
+    bool warmup_;
+    bool steady_;
+
+    bool loop_;
+    size_t unroll_limit_;
+    std::deque<LoopCode> loops_;
+    std::vector<LoopCode*> active_loops_;
+    std::set<size_t> repeated_;
+    std::map<size_t, size_t> loop_registers_;
+    std::set<size_t> computed_;
+    std::vector<RegisterLoop> register_loops_;
+    bool compact_;
+    size_t proxies_;                // loop instances met by lowering
+
+    std::vector<std::string> native_keys_;
+    std::map<std::string, std::deque<std::pair<size_t, NativeWord*>>> adoptable_;
+    std::vector<std::pair<size_t, size_t>> adopted_;
+    std::vector<std::pair<const char*, size_t>> globals_;
+    std::vector<Carry> carried_;
+    std::map<const char*, const char*> interned_;
+
+    // natives are created again for clones
+    std::shared_ptr<Enviroment> creating_;
+    std::vector<NativeCreator*> creators_;
+    std::vector<std::optional<std::vector<Cell>>> bound_args_;
 
     friend struct Enviroment;
+    friend struct Transpiler;
+    friend struct LivePatch;
+    friend struct Pipeline;
 };
 
-struct StaticNativeWord : public NativeWord {
-    StaticNativeWord() {
-        first = false;
+// live coding: a new program is built on a worker thread while the running one goes on,
+// run() swaps them between two blocks. Stateful words of unchanged call sites ( same word and
+// bound configuration, in program order ) and typed global variables move to the new program.
+// A faded reload starts the new program from scratch instead, and the output variable of
+// both programs is mixed over some blocks.
+struct LivePatch {
+    LivePatch(Enviroment& env, const std::string& txt, const std::string& output = "") : base_(env), output_(output) {
+        Enviroment first = base_;
+        auto main_code = first.compile(txt);
+        current_ = new Runtime(first, main_code);
+        latest_ = current_;
+        source_ = nullptr;
+        fading_ = nullptr;
+        fade_ = 0;
+        step_ = 0;
+        ready_fade_ = 0;
+        ready_ = nullptr;
+        retired_[0] = nullptr;
+        retired_[1] = nullptr;
     }
-    virtual void run(Stack& stack) {
-        if ( first == false ) {
-            first = true;
-            run_first(stack);
-            return;
+    ~LivePatch() {
+        if ( worker_.joinable() ) {
+            worker_.join();
         }
-        run_next(stack);
+        if ( Runtime* ready = ready_.exchange(nullptr) ) {
+            ready->disown();
+            delete ready;
+        }
+        collect();
+        delete fading_;
+        delete current_;
     }
-    virtual void run_first(Stack& stack) = 0;
-    virtual void run_next(Stack& stack) = 0;
+
+    // called from the control thread, a pending program not swapped in yet is dropped
+    void reload(const std::string& txt, size_t fade = 0) {
+        lr_assert(fade == 0 || output_.size() > 0, "A faded reload needs an output variable");
+        if ( worker_.joinable() ) {
+            worker_.join();
+        }
+        if ( Runtime* stale = ready_.exchange(nullptr) ) {
+            stale->disown();
+            delete stale;
+            latest_ = source_;
+        }
+        collect();
+
+        source_ = latest_;
+        worker_ = std::thread([this, txt, fade]() {
+            Enviroment env = base_;
+            // the first run of a reloaded program is on the audio thread, it doesn't strip static words
+            env.set_config("SteadyState", false);
+            auto main_code = env.compile(txt);
+            Runtime* rt = new Runtime(env, main_code, fade == 0 ? source_ : nullptr);
+            latest_ = rt;
+            ready_fade_ = fade;
+            ready_.store(rt);
+        });
+    }
+    // a reloaded program is built and waiting for the next block
+    bool pending() {
+        return ready_.load() != nullptr;
+    }
+
+    // called from the audio thread
+    void run() {
+        if ( fading_ != nullptr && step_ == fade_ ) {
+            retire(fading_);
+            fading_ = nullptr;
+        }
+        if ( fading_ == nullptr ) {
+            if ( Runtime* next = ready_.exchange(nullptr) ) {
+                swapping(next);
+            }
+        }
+
+        current_->run();
+        if ( fading_ != nullptr ) {
+            fading_->run();
+            from_ = (TNT)step_ / fade_;
+            step_++;
+            to_ = (TNT)step_ / fade_;
+        }
+    }
+    // the output variable after run(), a number when the program never set it
+    Cell output() {
+        Hash::Item* now = current_->global(output_);
+        Cell cell = now == nullptr ? Cell() : Hash::Item2Cell(now);
+        if ( fading_ == nullptr ) {
+            return cell;
+        }
+        Hash::Item* old = fading_->global(output_);
+        Cell before = old == nullptr ? Cell() : Hash::Item2Cell(old);
+        if ( before.is_string() || cell.is_string() ) {
+            return cell;
+        }
+        if ( before.is_number() && cell.is_number() ) {
+            return Cell( before.num() * (1 - to_) + cell.num() * to_ );
+        }
+
+        // vectors are ramped sample by sample, a number is held over the block
+        const Vec* a = before.is_vector() ? before.vec() : nullptr;
+        const Vec* b = cell.is_vector() ? cell.vec() : nullptr;
+        if ( a != nullptr && b != nullptr && a->size() != b->size() ) {
+            return cell;
+        }
+        const Vec* shape = b != nullptr ? b : a;
+        mixed_.resize( shape->rows(), shape->cols() );
+        const size_t n = mixed_.size();
+        for (size_t i = 0; i < n; i++) {
+            TNT g = from_ + (to_ - from_) * (TNT)(i + 1) / n;
+            TNT x = a != nullptr ? a->data()[i] : before.num();
+            TNT y = b != nullptr ? b->data()[i] : cell.num();
+            mixed_.data()[i] = x * (1 - g) + y * g;
+        }
+        return Cell(&mixed_);
+    }
+    Runtime& runtime() {
+        return *current_;
+    }
+
 private:
-    bool first;
+    void swapping(Runtime* next) {
+        if ( ready_fade_ == 0 ) {
+            next->take_over(*current_);
+            retire(current_);
+        } else {
+            fading_ = current_;
+            fade_ = ready_fade_;
+            step_ = 0;
+        }
+        current_ = next;
+    }
+    // old programs are deleted by the control thread, one faded and one swapped out between two reloads
+    void retire(Runtime* rt) {
+        for (auto& slot : retired_) {
+            Runtime* empty = nullptr;
+            if ( slot.compare_exchange_strong(empty, rt) ) {
+                return;
+            }
+        }
+        lr_panic("Too many retired programs!");
+    }
+    void collect() {
+        for (auto& slot : retired_) {
+            delete slot.exchange(nullptr);
+        }
+    }
+
+private:
+    const Enviroment base_;
+    const std::string output_;
+
+    // audio thread
+    Runtime* current_;
+    Runtime* fading_;
+    size_t fade_;
+    size_t step_;
+    TNT from_;
+    TNT to_;
+    Vec mixed_;
+
+    // control thread
+    std::thread worker_;
+    Runtime* latest_;
+    Runtime* source_;
+
+    size_t ready_fade_;
+    std::atomic<Runtime*> ready_;
+    std::atomic<Runtime*> retired_[2];
+};
+
+// pipelined stages: "%stage" splits the main code, every stage is a runtime with its own variables.
+// Cells left on the stack at a boundary reach the next stage through a single producer / single
+// consumer ring of blocks with atomic indexes. Stages after the first one run on their own threads
+// as soon as a block is there, the first one runs on the caller's thread and never waits for them
+struct Pipeline {
+    Pipeline(Enviroment& env, const std::string& txt) {
+        auto main_code = env.compile(txt);
+        std::vector<UserWord> parts(1);
+        for (auto& code : main_code) {
+            if ( code.type_ == WordCode::Builtin && code.str_ == "%stage" ) {
+                parts.push_back( UserWord() );
+                continue;
+            }
+            parts.back().push_back(code);
+        }
+
+        // a stage is typed with the cells the stage before leaves on its stack
+        std::string types;
+        for (size_t k = 0; k < parts.size(); k++) {
+            UserWord code;
+            if ( k > 0 ) {
+                code.push_back( WordCode::new_builtin("%stage.in " + types) );
+            }
+            code.insert( code.end(), parts[k].begin(), parts[k].end() );
+            if ( k + 1 < parts.size() ) {
+                code.push_back( WordCode::new_builtin("%stage.out") );
+                queues_.emplace_back();
+            }
+
+            stages_.emplace_back();
+            Stage& stage = stages_.back();
+            stage.rt = new Runtime(env, code);
+            stage.in = nullptr;
+            stage.out = nullptr;
+            stage.parked = false;
+            for (auto op : stage.rt->builtins_) {
+                if ( auto in = dynamic_cast<Runtime::BuiltinStageInput*>(op) ) {
+                    stage.in = in;
+                } else if ( auto out = dynamic_cast<Runtime::BuiltinStageOutput*>(op) ) {
+                    stage.out = out;
+                }
+            }
+            if ( stage.out != nullptr ) {
+                types = stage.rt->verified() ? stage.out->types : "?";
+            }
+        }
+
+        stop_ = false;
+        dropped_ = 0;
+        for (size_t k = 1; k < stages_.size(); k++) {
+            workers_.emplace_back( [this, k]() {
+                working(k);
+            });
+        }
+    }
+    ~Pipeline() {
+        draining();
+        stop_ = true;
+        for (size_t k = 1; k < stages_.size(); k++) {
+            std::lock_guard<std::mutex> guard(stages_[k].lock);
+            stages_[k].wake.notify_one();
+        }
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+        for (auto& stage : stages_) {
+            delete stage.rt;
+        }
+    }
+
+    // one block of the first stage, handed over to the second one. A full ring drops the block
+    // and returns false, the audio thread never waits for a slower stage
+    bool run() {
+        stages_[0].rt->run();
+        if ( queues_.size() == 0 ) {
+            return true;
+        }
+        if ( !pushing(queues_[0], stages_[0].out->cells) ) {
+            dropped_++;
+            return false;
+        }
+        waking(1);
+        return true;
+    }
+    // the next block has room in the ring, offline renders wait for it instead of dropping blocks
+    bool ready() {
+        if ( queues_.size() == 0 ) {
+            return true;
+        }
+        Queue& queue = queues_[0];
+        return queue.tail.load(std::memory_order_relaxed) - queue.head.load(std::memory_order_acquire) < Queue::depth;
+    }
+    // waits until the later stages ran every block handed over, not for the audio thread
+    void draining() {
+        for (auto& queue : queues_) {
+            while ( queue.head.load(std::memory_order_acquire) != queue.tail.load(std::memory_order_acquire) ) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    size_t stages() {
+        return stages_.size();
+    }
+    // blocks dropped because the second stage was a whole ring behind
+    size_t dropped() {
+        return dropped_;
+    }
+    Runtime& runtime(size_t k) {
+        return *stages_[k].rt;
+    }
+
+private:
+    // a ring of blocks, the producer only moves tail and the consumer only moves head
+    struct Queue {
+        static const size_t depth = 4;
+        struct Block {
+            std::vector<Cell> cells;
+            std::deque<Vec> vecs;
+        };
+        Block blocks[depth];
+        std::atomic<size_t> head{0};
+        std::atomic<size_t> tail{0};
+    };
+    struct Stage {
+        Runtime* rt;
+        Runtime::BuiltinStageInput* in;
+        Runtime::BuiltinStageOutput* out;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::atomic<bool> parked;
+    };
+
+    // a stage spins a while for its next block, then sleeps. The producer wakes it without the
+    // lock, a wake-up lost between the check and the wait costs one timeout at most
+    void working(size_t k) {
+        Stage& stage = stages_[k];
+        Queue& in = queues_[k - 1];
+        const size_t spins = 1 << 16;
+        while ( true ) {
+            size_t head = in.head.load(std::memory_order_relaxed);
+            for (size_t i = 0; in.tail.load(std::memory_order_acquire) == head && i < spins; i++) {
+            }
+            if ( in.tail.load(std::memory_order_acquire) == head ) {
+                std::unique_lock<std::mutex> guard(stage.lock);
+                stage.parked = true;
+                stage.wake.wait_for(guard, std::chrono::milliseconds(1), [this, &in, head]() {
+                    return stop_ || in.tail.load() != head;
+                });
+                stage.parked = false;
+            }
+            if ( in.tail.load(std::memory_order_acquire) == head ) {
+                if ( stop_ ) {
+                    return;
+                }
+                continue;
+            }
+
+            stage.in->cells = &in.blocks[head % Queue::depth].cells;
+            stage.rt->run();
+            // later stages aren't on the audio thread, they wait for room instead of dropping
+            if ( k < queues_.size() ) {
+                while ( !pushing(queues_[k], stage.out->cells) ) {
+                    std::this_thread::yield();
+                }
+                waking(k + 1);
+            }
+            in.head.store(head + 1, std::memory_order_release);
+        }
+    }
+    void waking(size_t k) {
+        if ( stages_[k].parked.load() ) {
+            stages_[k].wake.notify_one();
+        }
+    }
+
+    // vectors are copied, the next stage reads them while this one computes a new block
+    bool pushing(Queue& queue, std::vector<Cell>& cells) {
+        size_t tail = queue.tail.load(std::memory_order_relaxed);
+        if ( tail - queue.head.load(std::memory_order_acquire) == Queue::depth ) {
+            return false;
+        }
+        auto& block = queue.blocks[tail % Queue::depth];
+        block.cells.resize( cells.size() );
+        size_t v = 0;
+        for (size_t i = 0; i < cells.size(); i++) {
+            if ( !cells[i].is_vector() ) {
+                block.cells[i] = cells[i];
+                continue;
+            }
+            if ( v == block.vecs.size() ) {
+                block.vecs.emplace_back();
+            }
+            block.vecs[v] = *cells[i].vec();
+            block.cells[i] = Cell( &block.vecs[v] );
+            v++;
+        }
+        queue.tail.store(tail + 1);
+        return true;
+    }
+
+private:
+    std::deque<Stage> stages_;
+    std::deque<Queue> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<bool> stop_;
+    size_t dropped_;
 };
 
 #define NWORD_CREATOR_DEFINE_LR(CLS)         \
@@ -0,0 +1,473 @@
+#include <set>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <streambuf>
+#include <cstdio>
+
+#include "lr.hpp"
+#include "faust/faust_impl.hpp"
+#include "io/io_impl.hpp"
+#include "nn/nn_impl.hpp"
+
+/*
+Ahead-of-time backend, translating a verified program into a C++ translation unit.
+
+Numbers become local variables and script variables become members. Element-wise vector words
+become Eigen expressions, evaluated only where the value is consumed ( by a native, a variable
+or a dup ), so the compiler can inline and vectorize across words. Other native words are kept
+as instances and called through a scratch stack.
+*/
+
+namespace lr {
+
+struct Transpiler {
+    Transpiler(Enviroment& env, Runtime& rt) : env_(env), rt_(rt) {
+        next_ = 0;
+    }
+
+    void emit(std::ostream& os) {
+        lr_assert(rt_.verified_, "Only verified programs can be transpiled!");
+
+        for (size_t s = 0; s < rt_.hash_.slots(); s++) {
+            auto it = rt_.slot_types_.find(s);
+            if ( it == rt_.slot_types_.end() ) {
+                continue;
+            }
+            member(it->second, slot(s));
+            if ( rt_.hash_.valid(s) ) {
+                auto& item = rt_.hash_.get(s);
+                if ( item.index() == 0 ) {
+                    init_ << "        " << slot(s) << " = " << literal( std::get<0>(item) ) << ";" << std::endl;
+                } else if ( item.index() == 1 ) {
+                    init_ << "        " << slot(s) << " = " << quote( std::get<1>(item) ) << ";" << std::endl;
+                }
+            }
+        }
+
+        auto& bin = rt_.binaries_[0];
+        for (size_t i = 0; i < bin.size(); i++) {
+            auto& byte = bin[i];
+            switch( byte.type_ ) {
+                case WordByte::Number:
+                    push( Value{'n', literal(byte.num_)} );
+                    break;
+                case WordByte::String:
+                    push( Value{'s', quote(rt_.strings_[byte.idx_])} );
+                    break;
+                case WordByte::BuiltinOperator:
+                    builtin( rt_.builtins_[byte.idx_] );
+                    break;
+                case WordByte::Native:
+                    native( byte.idx_ );
+                    break;
+                case WordByte::User:
+                    lr_panic("Only fully inlined programs can be transpiled!");
+                    break;
+                case WordByte::Loop:
+                    lr_panic("Only unrolled loops can be transpiled!");
+                    break;
+            }
+        }
+        lr_assert(stack_.size() == 0, "Program must leave an empty stack!");
+
+        int sr = std::get<1>( env_.query_config("SampleRate") );
+        size_t bs = rt_.block_size();
+
+        os << "// generated by lr2cpp, do not edit" << std::endl;
+        os << "#include \"lr.hpp\"" << std::endl;
+        os << "#include \"faust/faust_impl.hpp\"" << std::endl;
+        os << "#include \"io/io_impl.hpp\"" << std::endl;
+        os << "#include \"nn/nn_impl.hpp\"" << std::endl;
+        os << std::endl;
+        os << "using namespace lr;" << std::endl;
+        os << std::endl;
+        os << "struct Patch {" << std::endl;
+        os << "    Patch(Enviroment& env) {" << std::endl;
+        os << init_.str();
+        os << "        first_ = true;" << std::endl;
+        os << "    }" << std::endl;
+        os << "    ~Patch() {" << std::endl;
+        os << cleanup_.str();
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "    void run() {" << std::endl;
+        os << body_.str();
+        os << "        first_ = false;" << std::endl;
+        os << "    }" << std::endl;
+        os << std::endl;
+        os << "private:" << std::endl;
+        os << "    Stack stack_;" << std::endl;
+        os << "    bool first_;" << std::endl;
+        os << members_.str();
+        os << "};" << std::endl;
+        os << std::endl;
+        os << "int main(int argc, const char* argv[]) {" << std::endl;
+        os << "    Enviroment env(" << sr << ");" << std::endl;
+        os << "    io::init_words(env);" << std::endl;
+        os << "    faust::init_words(env);" << std::endl;
+        os << "    nn::init_words(env);" << std::endl;
+        os << "    env.set_config(\"BlockSize\", " << bs << ");" << std::endl;
+        os << "    env.set_config(\"FastMath\", " << (env_.fast_math() ? "true" : "false") << ");" << std::endl;
+        os << std::endl;
+        os << "    Patch patch(env);" << std::endl;
+        os << "    for (size_t i = 0; i < " << sr << "; i += " << bs << ") {" << std::endl;
+        os << "        patch.run();" << std::endl;
+        os << "    }" << std::endl;
+        os << "}" << std::endl;
+    }
+
+private:
+    struct Value {
+        char type;                  // 'n', 's' or 'v'
+        std::string expr;           // C++ expression, vectors are Eigen array expressions
+        std::string ptr;            // pointer of a vector living in a buffer, empty for lazy expressions
+        std::set<size_t> slots;     // variables read by the expression
+    };
+
+    static std::string literal(TNT v) {
+        if ( std::isnan(v) ) {
+            return "std::numeric_limits<TNT>::quiet_NaN()";
+        }
+        if ( std::isinf(v) ) {
+            return v > 0 ? "std::numeric_limits<TNT>::infinity()" : "(-std::numeric_limits<TNT>::infinity())";
+        }
+        // hex float keeps the exact bits
+        char buf[64];
+        snprintf(buf, sizeof(buf), "(%af)", (double)v);
+        return buf;
+    }
+
+    static std::string quote(const char* str) {
+        std::string ret = "\"";
+        for (const char* c = str; *c != 0; c++) {
+            if ( *c == '"' || *c == '\\' ) {
+                ret.push_back('\\');
+                ret.push_back(*c);
+            } else if ( *c == '\n' ) {
+                ret += "\\n";
+            } else {
+                ret.push_back(*c);
+            }
+        }
+        return ret + "\"";
+    }
+
+    static std::string slot(size_t s) {
+        return "slot" + std::to_string(s) + "_";
+    }
+
+    std::string fresh(const char* prefix) {
+        return prefix + std::to_string(next_++);
+    }
+
+    void member(char type, const std::string& name) {
+        if ( type == 'n' ) {
+            members_ << "    TNT " << name << ";" << std::endl;
+        } else if ( type == 's' ) {
+            members_ << "    const char* " << name << ";" << std::endl;
+        } else {
+            members_ << "    Vec " << name << ";" << std::endl;
+        }
+    }
+
+    // numbers and strings are evaluated into locals at once
+    Value local(char type, const std::string& expr) {
+        if ( type == 'v' ) {
+            std::string name = fresh("v");
+            body_ << "        const Vec* " << name << " = " << expr << ";" << std::endl;
+            return Value{'v', "(*" + name + ")", name};
+        }
+        std::string name = fresh(type == 'n' ? "n" : "s");
+        body_ << "        const " << (type == 'n' ? "TNT " : "char* ") << name << " = " << expr << ";" << std::endl;
+        return Value{type, name};
+    }
+
+    // writing a vector expression into its own buffer
+    void materialize(Value& v, bool force = false) {
+        if ( v.type != 'v' || ( v.ptr != "" && force == false ) ) {
+            return;
+        }
+        std::string name = fresh("t") + "_";
+        member('v', name);
+        body_ << "        " << name << " = " << v.expr << ";" << std::endl;
+        v = Value{'v', name, "&" + name};
+    }
+
+    // values reading a variable must be copied before it is overwritten
+    void protect(size_t s) {
+        for (auto& v : stack_) {
+            if ( v.slots.find(s) != v.slots.end() ) {
+                materialize(v, true);
+            }
+        }
+    }
+
+    void push(const Value& v) {
+        stack_.push_back(v);
+    }
+    Value pop() {
+        lr_assert(stack_.size() > 0, "Stack underflow in transpiling!");
+        Value v = stack_.back();
+        stack_.pop_back();
+        return v;
+    }
+
+    static Value combine(const std::string& expr, const Value& a, const Value& b) {
+        Value v{'v', expr};
+        v.slots = a.slots;
+        v.slots.insert(b.slots.begin(), b.slots.end());
+        return v;
+    }
+
+    void builtin(BuiltinOperator* op) {
+        if ( auto get = dynamic_cast<Runtime::BuiltinSlotGet*>(op) ) {
+            char t = rt_.slot_types_[get->slot];
+            if ( t == 'v' ) {
+                push( Value{'v', slot(get->slot), "&" + slot(get->slot), {get->slot}} );
+            } else {
+                push( local(t, slot(get->slot)) );
+            }
+        } else if ( auto sget = dynamic_cast<Runtime::BuiltinSlotStaticGet*>(op) ) {
+            char t = rt_.slot_types_[sget->slot];
+            std::string name = fresh("cache") + "_";
+            member(t, name);
+            body_ << "        if ( first_ ) {" << std::endl;
+            body_ << "            " << name << " = " << slot(sget->slot) << ";" << std::endl;
+            body_ << "        }" << std::endl;
+            push( Value{t, name, t == 'v' ? "&" + name : ""} );
+        } else if ( auto set = dynamic_cast<Runtime::BuiltinSlotSet*>(op) ) {
+            Value v = pop();
+            protect(set->slot);
+            body_ << "        " << slot(set->slot) << " = " << v.expr << ";" << std::endl;
+        } else if ( auto sset = dynamic_cast<Runtime::BuiltinSlotStaticSet*>(op) ) {
+            Value v = pop();
+            protect(sset->slot);
+            body_ << "        if ( first_ ) {" << std::endl;
+            body_ << "            " << slot(sset->slot) << " = " << v.expr << ";" << std::endl;
+            body_ << "        }" << std::endl;
+        } else {
+            lr_panic("Can't transpile variable access resolved at run time!");
+        }
+    }
+
+    void native(size_t idx) {
+        const std::string& name = rt_.native_names_[idx];
+        const WordSignature* pick = rt_.picks_[idx];
+        if ( inline_native(name, pick) ) {
+            return;
+        }
+
+        // ? prints the whole stack without consuming it
+        std::vector<Value> ins;
+        size_t n = name == "?" ? stack_.size() : pick->in_.size();
+        for (size_t i = 0; i < n; i++) {
+            ins.insert(ins.begin(), pop());
+        }
+        std::string out = outputs(pick, ins);
+
+        std::string word = fresh("w") + "_";
+        members_ << "    NativeWord* " << word << ";" << std::endl;
+        init_ << "        " << word << " = env.create_native(" << quote(name.c_str()) << ");" << std::endl;
+        cleanup_ << "        delete " << word << ";" << std::endl;
+
+        for (auto& v : ins) {
+            materialize(v);
+            if ( v.type == 'v' ) {
+                body_ << "        stack_.raw_push( Cell( const_cast<Vec*>(" << v.ptr << ") ) );" << std::endl;
+            } else {
+                body_ << "        stack_.raw_push( Cell(" << v.expr << ") );" << std::endl;
+            }
+        }
+        body_ << "        " << word << "->run(stack_);" << std::endl;
+
+        if ( name == "?" ) {
+            body_ << "        stack_.clear();" << std::endl;
+            for (auto& v : ins) {
+                push(v);
+            }
+            return;
+        }
+
+        std::vector<Value> results(out.size());
+        for (size_t i = out.size(); i > 0; i--) {
+            char t = out[i-1];
+            std::string cell = "stack_.raw_pop()";
+            results[i-1] = local(t, cell + (t == 'n' ? ".num()" : t == 's' ? ".str()" : ".vec()"));
+            // an output may be one of the inputs
+            for (auto& v : ins) {
+                results[i-1].slots.insert(v.slots.begin(), v.slots.end());
+            }
+        }
+        for (auto& v : results) {
+            push(v);
+        }
+    }
+
+    // output types of a signature, binding its type variables to the inputs
+    static std::string outputs(const WordSignature* pick, const std::vector<Value>& ins) {
+        std::map<char, char> vars;
+        size_t base = ins.size() - pick->in_.size();
+        for (size_t i = 0; i < pick->in_.size(); i++) {
+            vars[ pick->in_[i] ] = ins[base + i].type;
+        }
+        std::string out;
+        for (auto c : pick->out_) {
+            out.push_back( (c == 'n' || c == 's' || c == 'v') ? c : vars[c] );
+        }
+        return out;
+    }
+
+    // stack words and math words are written as expressions
+    bool inline_native(const std::string& name, const WordSignature* pick) {
+        static const std::set<std::string> bin_ops = {"+", "-", "*", "/"};
+        static const std::set<std::string> uni_ops = {"abs", "arg", "exp", "log", "log1p", "log10", "sqrt",
+                                                      "sin", "cos", "tan", "asin", "acos", "atan",
+                                                      "sinh", "cosh", "tanh", "asinh", "acosh", "atanh",
+                                                      "ceil", "floor", "round"};
+        static const std::set<std::string> approx_ops = {"exp", "log", "sin", "cos", "tanh"};
+
+        if ( name == "drop" ) {
+            pop();
+        } else if ( name == "dup" ) {
+            Value a = pop();
+            materialize(a);
+            push(a);
+            push(a);
+        } else if ( name == "swap" ) {
+            Value b = pop();
+            Value a = pop();
+            push(b);
+            push(a);
+        } else if ( name == "rot" ) {
+            Value c = pop();
+            Value b = pop();
+            Value a = pop();
+            push(b);
+            push(c);
+            push(a);
+        } else if ( name == "dup2" ) {
+            Value b = pop();
+            Value a = pop();
+            materialize(a);
+            materialize(b);
+            for (int i = 0; i < 3; i++) {
+                push(a);
+                push(b);
+            }
+        } else if ( name == "math.pi" ) {
+            push( local('n', "M_PI") );
+        } else if ( name == "math.e" ) {
+            push( local('n', "M_E") );
+        } else if ( bin_ops.count(name) ) {
+            // a is the top cell, the vector ( if any ) goes first like the native word
+            Value a = pop();
+            Value b = pop();
+            std::string expr = "(" + a.expr + " " + name + " " + b.expr + ")";
+            if ( a.type == 'n' ) {
+                push( local('n', expr) );
+            } else {
+                push( combine(expr, a, b) );
+            }
+        } else if ( uni_ops.count(name) && !(env_.fast_math() && approx_ops.count(name)) ) {
+            Value a = pop();
+            if ( a.type == 'n' ) {
+                push( local('n', "std::" + name + "(" + a.expr + ")") );
+            } else {
+                push( combine("(" + a.expr + ")." + name + "()", a, a) );
+            }
+        } else if ( name == "inv" ) {
+            Value a = pop();
+            if ( a.type == 'n' ) {
+                push( local('n', "1.0 / " + a.expr) );
+            } else {
+                push( combine("(" + a.expr + ").inverse()", a, a) );
+            }
+        } else if ( name == "pow" ) {
+            Value a = pop();
+            Value b = pop();
+            if ( a.type == 'n' ) {
+                push( local('n', "std::pow(" + a.expr + ", " + b.expr + ")") );
+            } else {
+                push( combine("(" + a.expr + ").pow(" + b.expr + ")", a, b) );
+            }
+        } else if ( name == "%" ) {
+            Value a = pop();
+            Value b = pop();
+            push( local('n', "fmod(" + a.expr + ", " + b.expr + ")") );
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+private:
+    Enviroment& env_;
+    Runtime& rt_;
+
+    std::vector<Value> stack_;
+    size_t next_;
+
+    std::ostringstream members_;
+    std::ostringstream init_;
+    std::ostringstream cleanup_;
+    std::ostringstream body_;
+};
+
+}
+
+std::string fileToString(const char* filename) {
+    std::ifstream t(filename);
+    std::string str;
+
+    t.seekg(0, std::ios::end);
+    str.reserve(t.tellg());
+    t.seekg(0, std::ios::beg);
+
+    str.assign((std::istreambuf_iterator<char>(t)),
+        std::istreambuf_iterator<char>());
+
+    return str;
+}
+
+// lr2cpp [-b block_size] [-f] files... > patch.cpp
+int main(int argc, const char* argv[] ) {
+    lr::Enviroment env(16000);
+    lr::io::init_words(env);
+    lr::faust::init_words(env);
+    lr::nn::init_words(env);
+
+    // vector expressions are fused by the C++ compiler
+    env.set_config("FuseVectorWords", false);
+    // the transpiler reads plain unrolled stack code, natives get all their arguments
+    env.set_config("Peephole", false);
+    env.set_config("BindConfigArgs", false);
+    env.set_config("LoopOpcode", false);
+
+    int first = 1;
+    while ( first < argc && argv[first][0] == '-' ) {
+        std::string opt = argv[first];
+        if ( opt == "-b" && first + 1 < argc ) {
+            env.set_config("BlockSize", std::stoi(argv[first + 1]));
+            first += 2;
+        } else if ( opt == "-f" ) {
+            env.set_config("FastMath", true);
+            first += 1;
+        } else {
+            std::cerr << "usage: lr2cpp [-b block_size] [-f] files..." << std::endl;
+            return 1;
+        }
+    }
+
+    std::string codes;
+    for (int i = first; i < argc; i++) {
+        auto txt = fileToString(argv[i]);
+        codes = codes + "\n" + txt;
+    }
+
+    auto rt = env.build(codes);
+    lr::Transpiler tr(env, rt);
+    tr.emit(std::cout);
+}
@@ -7,7 +7,7 @@
 namespace lr { namespace nn {
 
 void init_words(Enviroment& env) {
-    env.insert_native_word("nn.wavenet", wavenet::WaveNetWord::creator);
+    env.insert_native_word("nn.wavenet", wavenet::WaveNetWord::creator, {"v n n n n s -- v"});
 }
 
 }}
@@ -1,10 +1,12 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <mutex>
 #include <Eigen/Core>
 #include <Eigen/StdVector>
 
 #include "lr.hpp"
+#include "fastmath.hpp"
 #include "nn/wavenet.hpp"
 
 /*
@@ -98,6 +100,13 @@ void HiddenLayer::processOneSample(const TNT* sample, size_t t) {
     }
 
     // 2. gated activation
+    if ( fast_math_ ) {
+        TNT* out = out_.data() + t * channels_;
+        for (size_t i = 0; i < channels_; i++) {
+            out[i] = fastmath::tanh( gate_out_[i] ) * fastmath::sigmoid( gate_out_[i + channels_] );
+        }
+        return;
+    }
     for (size_t i = 0; i < channels_; i++) {
         TNT o1 = tanh( gate_out_[i]);
         TNT o2 = sigmoid( gate_out_[i + channels_]);
@@ -165,7 +174,7 @@ void WaveNet::init() {
         ss << "filter.hidden." << i << ".";
         current_weight_ = ss.str();
 
-        auto hidden = new  HiddenLayer(channels_, dialations_[i], kernel_size_, this);
+        auto hidden = new  HiddenLayer(channels_, dialations_[i], kernel_size_, fast_math_, this);
         hiddens_.push_back( hidden );
     }
 
@@ -188,28 +197,41 @@ void WaveNet::new_weight(std::vector<TNT>& w, std::vector<TNT>& b) {
     lr_assert(current_weight_ != "", "target vector name error");
 
     std::string wname = current_weight_ + "weight";
-    std::vector<TNT>& w_ = weights_[ wname ];
+    auto w_it = weights_->find( wname );
+    lr_assert(w_it != weights_->end(), "Can't find weight vector");
+    const std::vector<TNT>& w_ = w_it->second;
     lr_assert(w_.size() == w.size(), " weight vector must has same size");
     w.assign(w_.begin(), w_.end());
 
     std::string bname = current_weight_ + "bias";
-    std::vector<TNT>& b_ = weights_[ bname ];
+    auto b_it = weights_->find( bname );
+    lr_assert(b_it != weights_->end(), "Can't find bias vector");
+    const std::vector<TNT>& b_ = b_it->second;
 
     lr_assert(b_.size() == b.size(), " weight vector must has same size");
     b.assign(b_.begin(), b_.end());
 }
 
-void WaveNet::load_weight(const char* file_name) {
+std::shared_ptr<const WaveNet::Weights> WaveNet::load_weight(const char* file_name) {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const Weights>> loaded;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if ( auto weights = loaded[file_name].lock() ) {
+        return weights;
+    }
+
     std::ifstream wfile(file_name);
     lr_assert(wfile.is_open(), "Can't open weight file");
 
+    auto parsed = std::make_shared<Weights>();
     std::string line;
     std::string name;
     std::vector<TNT> vec;
     while (getline( wfile, line)) {
         if ( line.find("- ") == 0) {
             if ( vec.size() > 0 ) {
-                weights_[name] = vec;
+                (*parsed)[name] = vec;
                 vec.clear();
             }
             name = line.substr(2, line.size() - 3);
@@ -222,8 +244,11 @@ void WaveNet::load_weight(const char* file_name) {
     }
 
     if ( vec.size() > 0 ) {
-        weights_[name] = vec;
+        (*parsed)[name] = vec;
     }
+
+    loaded[file_name] = parsed;
+    return parsed;
 }
 
 void WaveNet::process(const TNT* data, size_t length) {
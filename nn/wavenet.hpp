@@ -35,9 +35,10 @@ struct HiddenLayer {
     HiddenLayer(const size_t channels,
                 const size_t dialation,
                 const size_t kernel_size,
+                const bool fast_math,
                 ParameterRegister* reg) :
         channels_(channels), dialation_(dialation), kernel_size_(kernel_size) ,
-        fifo_order_( (kernel_size - 1) * dialation + 1) {
+        fifo_order_( (kernel_size - 1) * dialation + 1), fast_math_(fast_math) {
 
         gate_kernel_.resize(2 * channels * channels * kernel_size);
         gate_bias_.resize(2 * channels);
@@ -63,6 +64,7 @@ private:
     const size_t dialation_;
     const size_t kernel_size_;
     const size_t fifo_order_;           // (kernel_size - 1) * dialation + 1
+    const bool fast_math_;              // approximated tanh and sigmoid
 
     std::vector<TNT> gate_kernel_;      // output channel * input channel * kernel size
     std::vector<TNT> gate_bias_;        // output channel
@@ -125,10 +127,10 @@ private:
 
 
 struct WaveNet : public ParameterRegister {
-    WaveNet (size_t channels, size_t kernel_size, const std::vector<size_t>& dialations, const char* weight_file):
-        channels_(channels), kernel_size_(kernel_size), dialations_(dialations) {
+    WaveNet (size_t channels, size_t kernel_size, const std::vector<size_t>& dialations, const char* weight_file, bool fast_math):
+        channels_(channels), kernel_size_(kernel_size), dialations_(dialations), fast_math_(fast_math) {
 
-        load_weight(weight_file);
+        weights_ = load_weight(weight_file);
         init();
     }
     virtual ~WaveNet();
@@ -138,18 +140,29 @@ struct WaveNet : public ParameterRegister {
     const std::vector<TNT>& output() {
         return mixer_->output();
     }
+    // samples of input reaching one output sample
+    size_t receptive_field() {
+        size_t field = 1;
+        for (auto d : dialations_) {
+            field += (kernel_size_ - 1) * d;
+        }
+        return field;
+    }
 
 private:
-    void load_weight(const char* file_name);
+    using Weights = std::map<const std::string, std::vector<TNT>>;
+    // parsed files are shared by all networks ( voices ) loading them
+    static std::shared_ptr<const Weights> load_weight(const char* file_name);
     void init();
 
 private:
     size_t  channels_;
     size_t  kernel_size_;
     std::vector<size_t> dialations_;
+    bool fast_math_;
 
     std::string current_weight_;
-    std::map<const std::string, std::vector<TNT>> weights_;
+    std::shared_ptr<const Weights> weights_;
 
     InputLayer* input_;
     std::vector<HiddenLayer*> hiddens_;
@@ -158,9 +171,12 @@ private:
 
 };
 
-struct WaveNetWord : public lr::NativeWord {
-    WaveNetWord() {
+struct WaveNetWord : public lr::ConfigNativeWord {
+    // vin channels kernel_size dialation repeat file_name
+    WaveNetWord(bool fast_math, bool skip_silence) : ConfigNativeWord(5), fast_math_(fast_math), skip_silence_(skip_silence) {
         net_ = nullptr;
+        held_for_ = 0;
+        steady_ = false;
     }
     virtual ~WaveNetWord() {
         if ( net_ != nullptr ) {
@@ -168,28 +184,38 @@ struct WaveNetWord : public lr::NativeWord {
         }
     }
 
-    virtual void run(Stack& stack) {
-        const char* file_name = stack.pop_string();
-        size_t repeat = stack.pop_number();
-        size_t dialation = stack.pop_number();
-        size_t kernel_size = stack.pop_number();
-        size_t channels = stack.pop_number();
-
-        if ( net_ == nullptr) {
-            std::vector<size_t> ds;
-            for(size_t r = 0; r < repeat; r++) {
-                for(size_t i = 0; i < dialation; i++) {
-                    ds.push_back( 1 << i );
-                }
+    virtual void configure(std::vector<Cell>& args) {
+        size_t channels = args[0].as_number();
+        size_t kernel_size = args[1].as_number();
+        size_t dialation = args[2].as_number();
+        size_t repeat = args[3].as_number();
+        const char* file_name = args[4].as_string();
+
+        std::vector<size_t> ds;
+        for(size_t r = 0; r < repeat; r++) {
+            for(size_t i = 0; i < dialation; i++) {
+                ds.push_back( 1 << i );
             }
-            net_ = new WaveNet(channels, kernel_size, ds, file_name);
         }
+        net_ = new WaveNet(channels, kernel_size, ds, file_name, fast_math_);
+    }
 
+    virtual void run_configured(Stack& stack) {
         auto v = stack.pop_vector();
+
+        // a constant input flushing the receptive field leaves every layer in its steady state,
+        // the output stays at its last value while the input holds the same value
+        bool constant = skip_silence_ && v->size() > 0 && is_constant(*v);
+        if ( constant && steady_ && vec.size() == v->size() && (*v)(0) == held_ ) {
+            vec.setConstant(steady_value_);
+            stack.push_vector(&vec);
+            return;
+        }
+
         net_->process(v->data(), v->size());
 
         // copy to output
-        auto out = net_->output();
+        auto& out = net_->output();
         if ( vec.size() != (int)out.size() ) {
             vec = Vec::Zero(out.size(), 1);
         }
@@ -198,13 +224,35 @@ struct WaveNetWord : public lr::NativeWord {
             d[i] = out[i];
         }
 
+        if ( !constant ) {
+            held_for_ = 0;
+        } else if ( held_for_ > 0 && (*v)(0) == held_ ) {
+            held_for_ += v->size();
+        } else {
+            held_ = (*v)(0);
+            held_for_ = v->size();
+        }
+        steady_ = held_for_ >= net_->receptive_field() && out.size() > 0;
+        if ( steady_ ) {
+            steady_value_ = out.back();
+        }
+
         stack.push_vector(&vec);
     }
 
-    NWORD_CREATOR_DEFINE_LR(WaveNetWord)
+    static NativeWord* creator(Enviroment& env) {
+        return new WaveNetWord( env.fast_math(), env.skip_silence() );
+    }
 private:
+    const bool fast_math_;
+    const bool skip_silence_;
     WaveNet* net_;
     Vec vec;
+
+    TNT held_;              // value of a constant input
+    size_t held_for_;       // samples the input held it
+    bool steady_;
+    TNT steady_value_;
 };
 
 
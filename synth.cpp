@@ -30,13 +30,57 @@ int main(int argc, const char* argv[] ) {
     lr::faust::init_words(env);
     lr::nn::init_words(env);
 
+    // synth [-b block_size] [-k control_rate] [-s] [-c cache.lrc] [-p] files...
+    int first = 1;
+    bool stats = false;
+    bool pipeline = false;
+    std::string cache;
+    while ( first < argc && argv[first][0] == '-' ) {
+        std::string opt = argv[first];
+        if ( opt == "-b" && first + 1 < argc ) {
+            env.set_config("BlockSize", std::stoi(argv[first + 1]));
+            first += 2;
+        } else if ( opt == "-k" && first + 1 < argc ) {
+            env.set_config("ControlRate", std::stoi(argv[first + 1]));
+            first += 2;
+        } else if ( opt == "-s" ) {
+            stats = true;
+            first += 1;
+        } else if ( opt == "-p" ) {
+            pipeline = true;
+            first += 1;
+        } else if ( opt == "-c" && first + 1 < argc ) {
+            cache = argv[first + 1];
+            first += 2;
+        } else {
+            break;
+        }
+    }
+
     std::string codes;
-    for (int i = 1; i < argc; i++) {
+    for (int i = first; i < argc; i++) {
         auto txt = fileToString(argv[i]);
         codes = codes + "\n" + txt;
     }
 
-    auto rt = env.build(codes);
+    // stages split by %stage run on their own threads, a render waits for room in the ring
+    // instead of dropping blocks, the later stages run the last ones before pipe is gone
+    if ( pipeline ) {
+        lr::Pipeline pipe(env, codes);
+        for (size_t i = 0; i < 16000; i++) {
+            while ( !pipe.ready() ) {
+                std::this_thread::yield();
+            }
+            pipe.run();
+        }
+        return 0;
+    }
+
+    // 16000 runs, every run computes one block ( BlockSize samples, a frame for the frame based examples )
+    auto rt = cache.empty() ? env.build(codes) : env.build(codes, cache);
+    if ( stats ) {
+        rt.dump_peephole(std::cerr);
+    }
     for (size_t i = 0; i < 16000; i++) {
         rt.run();
     }